@@ -0,0 +1,222 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+/*
+ Runs the compiler end-to-end over a set of synthetic programs produced by the generator,
+ one scenario per knob, and writes lines/s, peak resident memory and the time spent in each
+ stage of the compiler as JSON so that runs from different commits can be compared.
+ 
+ Usage: bench [-p <compiler>] [-g <generator>] [-d <directory>] [-r <runs>] [-o <json>]
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "process.hpp"
+
+typedef struct TScenario {
+    const char *name;
+    std::vector<std::string> arguments;
+} TScenario;
+
+typedef struct TResult {
+    std::string name;
+    long lines = 0;
+    double seconds = 0;
+    double wall = 0;            // measured here, being finer grained than the compiler's own report
+    long peakRSS = 0;
+    std::vector<std::pair<std::string, double>> stages;
+    double percent = 0;         // of every stage row, which should account for the whole compile
+} TResult;
+
+// Each scenario scales a single knob of the generator well beyond the baseline.
+static const TScenario _scenarios[] = {
+    {"baseline", {}},
+    {"functions", {"-functions", "500"}},
+    {"defines", {"-defines", "2000"}},
+    {"loops", {"-depth", "6", "-statements", "8"}},
+    {"switches", {"-switches", "8"}},
+    {"strings", {"-strings", "16"}},
+    {"includes", {"-includes", "16"}}
+};
+
+// MARK: - Parsing
+
+/*
+ Picks the line count and compile time out of "Compiled in 0.12 seconds (1234 lines, ...)"
+ and the per-stage times and percentages out of the table printed by -v t.
+ */
+static bool parse(const std::string& output, TResult& result) {
+    std::istringstream is(output);
+    std::string line;
+    bool found = false;
+    bool stages = false;
+    
+    while (std::getline(is, line)) {
+        if (line.starts_with("Compiled in ")) {
+            found = sscanf(line.c_str(), "Compiled in %lf seconds (%ld lines", &result.seconds, &result.lines) == 2;
+            continue;
+        }
+        if (line.starts_with("stage ")) {
+            stages = true;
+            continue;
+        }
+        if (!stages) continue;
+        if (line.empty()) break;
+        
+        char name[64];
+        long calls;
+        double ms, percent;
+        if (sscanf(line.c_str(), "%63s %ld %lf %lf", name, &calls, &ms, &percent) == 4) {
+            result.stages.push_back({name, ms});
+            result.percent += percent;
+        }
+    }
+    
+    return found;
+}
+
+// MARK: - JSON
+
+static void writeJSON(std::ostream& os, const std::string& compiler, int runs, const std::vector<TResult>& results) {
+    os << "{\n";
+    os << "  \"compiler\": \"" << compiler << "\",\n";
+    os << "  \"runs\": " << runs << ",\n";
+    os << "  \"scenarios\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const TResult& result = results[i];
+        
+        os << "    {\n";
+        os << "      \"name\": \"" << result.name << "\",\n";
+        os << "      \"lines\": " << result.lines << ",\n";
+        os << "      \"seconds\": " << result.seconds << ",\n";
+        os << "      \"wall_seconds\": " << result.wall << ",\n";
+        os << "      \"lines_per_second\": " << (result.wall > 0 ? (long)(result.lines / result.wall) : 0) << ",\n";
+        os << "      \"peak_rss_kb\": " << result.peakRSS << ",\n";
+        os << "      \"stages_ms\": {";
+        for (size_t s = 0; s < result.stages.size(); ++s) {
+            os << (s ? ", " : " ") << "\"" << result.stages[s].first << "\": " << result.stages[s].second;
+        }
+        os << " }\n";
+        os << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n";
+    os << "}\n";
+}
+
+// MARK: - Main
+
+static void usage(void) {
+    std::cout << "Usage: bench [-p <compiler>] [-g <generator>] [-d <directory>] [-r <runs>] [-o <json>]\n";
+}
+
+int main(int argc, char **argv) {
+    std::string compiler = "bin/p+";
+    std::string generator = "bin/generate";
+    std::string directory = "/tmp/p+bench";
+    std::string filename = "bench/results.json";
+    int runs = 3;
+    
+    for (int n = 1; n < argc; n++) {
+        std::string args = argv[n];
+        
+        if (n + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        
+        if (args == "-p") compiler = argv[++n];
+        else if (args == "-g") generator = argv[++n];
+        else if (args == "-d") directory = argv[++n];
+        else if (args == "-o") filename = argv[++n];
+        else if (args == "-r") runs = std::max(1, atoi(argv[++n]));
+        else {
+            usage();
+            return 1;
+        }
+    }
+    
+    std::vector<TResult> results;
+    
+    printf("%-12s %10s %10s %12s %10s\n", "scenario", "lines", "seconds", "lines/s", "rss kb");
+    for (const auto& scenario : _scenarios) {
+        std::string path = directory + "/" + scenario.name;
+        std::string output;
+        long peakRSS;
+        
+        std::vector<std::string> arguments = {generator, "-o", path};
+        arguments.insert(arguments.end(), scenario.arguments.begin(), scenario.arguments.end());
+        if (run(arguments, output, peakRSS) != 0) {
+            std::cout << "bench: unable to generate '" << scenario.name << "'\n" << output;
+            return 1;
+        }
+        
+        // The fastest of the runs is kept, being the one least disturbed by the rest of the system.
+        TResult best;
+        for (int r = 0; r < runs; ++r) {
+            TResult result;
+            result.name = scenario.name;
+            output.clear();
+            
+            auto start = std::chrono::steady_clock::now();
+            int status = run({compiler, path + "/main.c", "-o", path + "/main.hpprgm", "-l", path, "-v", "t"}, output, result.peakRSS);
+            result.wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            
+            if (status != 0 || !parse(output, result)) {
+                std::cout << "bench: '" << scenario.name << "' failed to compile\n" << output;
+                return 1;
+            }
+            
+            // Each row is rounded to a tenth, so only allow for that much drift from the whole.
+            if (result.percent < 100.0 - 0.05 * result.stages.size() || result.percent > 100.0 + 0.05 * result.stages.size()) {
+                std::cout << "bench: '" << scenario.name << "' stages add up to " << result.percent << "% rather than 100%\n" << output;
+                return 1;
+            }
+            if (r == 0 || result.wall < best.wall) best = result;
+        }
+        
+        results.push_back(best);
+        printf("%-12s %10ld %10.3f %12.0f %10ld\n", best.name.c_str(), best.lines, best.wall,
+               best.wall > 0 ? best.lines / best.wall : 0, best.peakRSS);
+    }
+    
+    std::ofstream outfile;
+    outfile.open(filename, std::ios::out);
+    if (!outfile.is_open()) {
+        std::cout << "bench: unable to write '" << filename << "'\n";
+        return 1;
+    }
+    writeJSON(outfile, compiler, runs, results);
+    outfile.close();
+    
+    std::cout << "Results written to '" << filename << "'\n";
+    return 0;
+}
@@ -0,0 +1,230 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+/*
+ Generates a synthetic Prime-C program for benchmarking the compiler, made up of a main
+ program and a chain of included libraries, with the #defines spread across all of them.
+ 
+ Usage: generate -o <directory> [-functions <n>] [-defines <n>] [-depth <n>] [-statements <n>]
+                 [-switches <n>] [-strings <n>] [-includes <n>] [-seed <n>]
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <filesystem>
+#include <cstring>
+
+typedef struct TOptions {
+    std::string directory;
+    int functions = 50;         // functions in the main program
+    int defines = 100;          // #defines, a quarter of them function-like macros
+    int depth = 2;              // depth of the nested loops within each function
+    int statements = 4;         // statements within the innermost loop
+    int switches = 1;           // switch statements within each function
+    int strings = 2;            // string literals within each function
+    int includes = 2;           // depth of the chain of included libraries
+    unsigned seed = 1;
+} TOptions;
+
+static std::mt19937 _random;
+
+static int random(int n) {
+    return (int)(_random() % n);
+}
+
+static std::string indent(int level) {
+    return std::string(level * 4, ' ');
+}
+
+// An expression using whatever #defines the program has.
+static std::string expression(const TOptions& options, const std::string& variable) {
+    std::ostringstream os;
+    
+    os << variable;
+    if (options.defines > 0) {
+        int n = random(options.defines);
+        if (n % 4 == 3) {
+            os << " + M" << n << "(" << variable << ", " << random(100) << ")";
+        } else {
+            os << " * D" << n;
+        }
+    }
+    os << " + " << random(1000);
+    
+    return os.str();
+}
+
+static void writeDefines(std::ostream& os, const TOptions& options, int first, int last) {
+    for (int n = first; n < last; ++n) {
+        if (n % 4 == 3) {
+            os << "#define M" << n << "(a,b) ((a)*" << n << "+(b))\n";
+        } else {
+            os << "#define D" << n << " " << n + 1 << "\n";
+        }
+    }
+    os << "\n";
+}
+
+static void writeFunction(std::ostream& os, const TOptions& options, const std::string& name) {
+    os << "Int " << name << "(Int a, Int b)\n";
+    os << "{\n";
+    
+    os << indent(1) << "Int t = 0";
+    for (int i = 0; i < options.depth; ++i) os << ", i" << i;
+    os << ";\n";
+    
+    for (int i = 0; i < options.strings; ++i) {
+        os << indent(1) << "PRINT(\"text " << i << " >= && != x\");\n";
+    }
+    
+    for (int i = 0; i < options.depth; ++i) {
+        os << indent(i + 1) << "for (i" << i << " = 0; i" << i << " < " << 2 + random(10) << "; i" << i << " += 1) {\n";
+    }
+    for (int i = 0; i < options.statements; ++i) {
+        std::string variable = options.depth ? "i" + std::to_string(options.depth - 1) : "a";
+        if (i % 2) {
+            os << indent(options.depth + 1) << "t += " << expression(options, variable) << ";\n";
+        } else {
+            os << indent(options.depth + 1) << "if (t >= " << random(1000) << " && a != b) {\n";
+            os << indent(options.depth + 2) << "t = t - " << expression(options, "b") << ";\n";
+            os << indent(options.depth + 1) << "}\n";
+        }
+    }
+    for (int i = options.depth; i > 0; --i) {
+        os << indent(i) << "}\n";
+    }
+    
+    for (int i = 0; i < options.switches; ++i) {
+        os << indent(1) << "switch (a) {\n";
+        for (int c = 1; c <= 3; ++c) {
+            os << indent(2) << "case " << c << ":\n";
+            os << indent(3) << "t = t + " << expression(options, "a") << ";\n";
+            os << indent(3) << "break;\n";
+        }
+        os << indent(2) << "default:\n";
+        os << indent(3) << "t = 0;\n";
+        os << indent(1) << "}\n";
+    }
+    
+    os << indent(1) << "return t;\n";
+    os << "}\n\n";
+}
+
+static bool writeFile(const std::string& pathname, const std::string& contents) {
+    std::ofstream outfile;
+    outfile.open(pathname, std::ios::out);
+    if (!outfile.is_open()) return false;
+    outfile << contents;
+    outfile.close();
+    return !outfile.fail();
+}
+
+static bool generate(const TOptions& options) {
+    std::error_code error;
+    std::filesystem::create_directories(options.directory, error);
+    
+    // The defines are spread evenly across the main program and every library.
+    int files = options.includes + 1;
+    
+    for (int n = 1; n <= options.includes; ++n) {
+        std::ostringstream os;
+        os << "#ifndef BENCH" << n << "_PPLIB\n";
+        os << "#define BENCH" << n << "_PPLIB\n";
+        if (n < options.includes) os << "#include <bench" << n + 1 << ">\n";
+        writeDefines(os, options, options.defines * n / files, options.defines * (n + 1) / files);
+        os << "#endif\n";
+        
+        if (!writeFile(options.directory + "/bench" + std::to_string(n) + ".pplib", os.str())) return false;
+    }
+    
+    std::ostringstream os;
+    if (options.includes) os << "#include <bench1>\n";
+    writeDefines(os, options, 0, options.defines / files);
+    
+    for (int n = 0; n < options.functions; ++n) {
+        writeFunction(os, options, "fn" + std::to_string(n));
+    }
+    
+    os << "Int START()\n";
+    os << "{\n";
+    os << indent(1) << "Int t = 0;\n";
+    for (int n = 0; n < options.functions; ++n) {
+        os << indent(1) << "t = t + fn" << n << "(" << n << ", 1);\n";
+    }
+    os << indent(1) << "return t;\n";
+    os << "}\n";
+    
+    return writeFile(options.directory + "/main.c", os.str());
+}
+
+static void usage(void) {
+    std::cout << "Usage: generate -o <directory> [-functions <n>] [-defines <n>] [-depth <n>] [-statements <n>]\n";
+    std::cout << "                [-switches <n>] [-strings <n>] [-includes <n>] [-seed <n>]\n";
+}
+
+int main(int argc, char **argv) {
+    TOptions options;
+    
+    for (int n = 1; n < argc; n++) {
+        std::string args = argv[n];
+        
+        if (n + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        
+        int value = atoi(argv[++n]);
+        if (args == "-o") options.directory = argv[n];
+        else if (args == "-functions") options.functions = value;
+        else if (args == "-defines") options.defines = value;
+        else if (args == "-depth") options.depth = value;
+        else if (args == "-statements") options.statements = value;
+        else if (args == "-switches") options.switches = value;
+        else if (args == "-strings") options.strings = value;
+        else if (args == "-includes") options.includes = value;
+        else if (args == "-seed") options.seed = value;
+        else {
+            usage();
+            return 1;
+        }
+    }
+    
+    if (options.directory.empty()) {
+        usage();
+        return 1;
+    }
+    
+    _random.seed(options.seed);
+    if (!generate(options)) {
+        std::cout << "generate: unable to write to '" << options.directory << "'\n";
+        return 1;
+    }
+    
+    return 0;
+}
@@ -0,0 +1,275 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+/*
+ Times every fixed pattern of the compiler, as compiled into its own matcher by regex.hpp,
+ against std::regex built from the same expression, over the lines of a synthetic program and
+ of the PPL the compiler produces from it.
+ 
+ Every search, full match and iteration is also checked to give the same groups at the same
+ positions as std::regex, and any difference fails the run.
+ 
+ Usage: patterns [-p <compiler>] [-g <generator>] [-d <directory>] [-r <runs>]
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <regex>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+
+#include "process.hpp"
+#include "../src/patterns.hpp"
+
+using pp::Pattern;
+using pp::Match;
+using pp::MatchIterator;
+
+// Lines that the generator does not produce but that the patterns are written for.
+static const char *_edges[] = {
+    "",
+    " ",
+    "a = = b;",
+    "a == b != c <= d >= e",
+    "x[i][j] += y[(2) + 1] <<= 3;",
+    "#define MSG(a, b) \"hi\" a+b",
+    "#Define  NAME",
+    "  #END // done",
+    "#end",
+    "#include <lib/name>",
+    "#include \"name.pplib\"",
+    "#if NAME >= 10",
+    "/* a */ b /* c */",
+    "x := #FF:-16h + #777o",
+    "} UNTIL (a < b);",
+    "} WHILE (a AND NOT b);",
+    "a,,b, c,",
+    "≥≤≠▶π",
+    "L.push_back(1); L.front() L.back() L.at(12) L.length()"
+};
+
+typedef struct TResult {
+    const Pattern *pattern;
+    double reference = 0;      // seconds taken by std::regex
+    double compiled = 0;       // seconds taken by the compiled matcher
+} TResult;
+
+// MARK: - Corpus
+
+static std::string utf8(const std::u16string& s) {
+    std::string result;
+    for (char16_t c : s) {
+        if (c < 0x80) {
+            result.push_back(c);
+        } else if (c < 0x800) {
+            result.push_back(0xC0 | (c >> 6));
+            result.push_back(0x80 | (c & 0x3F));
+        } else {
+            result.push_back(0xE0 | (c >> 12));
+            result.push_back(0x80 | ((c >> 6) & 0x3F));
+            result.push_back(0x80 | (c & 0x3F));
+        }
+    }
+    return result;
+}
+
+static void readLines(std::istream& is, std::vector<std::string>& lines) {
+    std::string line;
+    while (std::getline(is, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        lines.push_back(line);
+    }
+}
+
+static bool readSource(const std::string& filename, std::vector<std::string>& lines) {
+    std::ifstream infile(filename);
+    if (!infile.is_open()) return false;
+    readLines(infile, lines);
+    return true;
+}
+
+static bool readPPL(const std::string& filename, std::vector<std::string>& lines) {
+    std::ifstream infile(filename, std::ios::binary);
+    if (!infile.is_open()) return false;
+    
+    std::u16string text;
+    char bytes[2];
+    while (infile.read(bytes, 2)) {
+        char16_t c = (unsigned char)bytes[0] | (unsigned char)bytes[1] << 8;
+        if (c != 0xFEFF) text.push_back(c);
+    }
+    
+    std::istringstream is(utf8(text));
+    readLines(is, lines);
+    return true;
+}
+
+// MARK: - Checking
+
+static bool same(const Match& match, const std::smatch& reference, const std::string& str) {
+    if (match.size() != reference.size()) return false;
+    for (size_t n = 0; n < match.size(); ++n) {
+        if (match[n].matched != reference[n].matched) return false;
+        if (!match[n].matched) continue;
+        if (match.position(n) != (size_t)reference.position(n) || match.length(n) != (size_t)reference.length(n)) return false;
+    }
+    return true;
+}
+
+static bool check(const Pattern& pattern, const std::regex& re, const std::string& str) {
+    Match match;
+    std::smatch reference;
+    
+    bool found = std::regex_search(str, reference, re);
+    if (pattern.search(str, match) != found || (found && !same(match, reference, str))) return false;
+    
+    found = std::regex_match(str, reference, re);
+    if (pattern.match(str, match) != found || (found && !same(match, reference, str))) return false;
+    
+    std::sregex_iterator ref(str.begin(), str.end(), re);
+    MatchIterator it = pattern.iterator(str);
+    for (; ref != std::sregex_iterator() && it != MatchIterator(); ++ref, ++it) {
+        if (!same(*it, *ref, str)) return false;
+    }
+    return ref == std::sregex_iterator() && it == MatchIterator();
+}
+
+// MARK: - Timing
+
+template <typename F>
+static double time(int runs, const F& f) {
+    double best = 0;
+    for (int r = 0; r < runs; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (r == 0 || seconds < best) best = seconds;
+    }
+    return best;
+}
+
+// MARK: - Main
+
+static void usage(void) {
+    std::cout << "Usage: patterns [-p <compiler>] [-g <generator>] [-d <directory>] [-r <runs>]\n";
+}
+
+int main(int argc, char **argv) {
+    std::string compiler = "bin/p+";
+    std::string generator = "bin/generate";
+    std::string directory = "/tmp/p+patterns";
+    int runs = 5;
+    
+    for (int n = 1; n < argc; n++) {
+        std::string args = argv[n];
+        
+        if (n + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        
+        if (args == "-p") compiler = argv[++n];
+        else if (args == "-g") generator = argv[++n];
+        else if (args == "-d") directory = argv[++n];
+        else if (args == "-r") runs = std::max(1, atoi(argv[++n]));
+        else {
+            usage();
+            return 1;
+        }
+    }
+    
+    std::string output;
+    long peakRSS;
+    if (run({generator, "-o", directory, "-functions", "40", "-switches", "2", "-strings", "4"}, output, peakRSS) != 0) {
+        std::cout << "patterns: unable to generate a corpus\n" << output;
+        return 1;
+    }
+    if (run({compiler, directory + "/main.c", "-o", directory + "/main.hpprgm", "-l", directory}, output, peakRSS) != 0) {
+        std::cout << "patterns: unable to compile the corpus\n" << output;
+        return 1;
+    }
+    
+    std::vector<std::string> lines;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        std::string extension = entry.path().extension().string();
+        if (extension == ".c" || extension == ".pplib") readSource(entry.path().string(), lines);
+    }
+    if (!readPPL(directory + "/main.hpprgm", lines)) {
+        std::cout << "patterns: unable to read '" << directory << "/main.hpprgm'\n";
+        return 1;
+    }
+    
+    lines.insert(lines.end(), std::begin(_edges), std::end(_edges));
+    
+    std::vector<TResult> results;
+    int failures = 0;
+    
+    for (const Pattern *pattern : Pattern::all()) {
+        auto flags = std::regex_constants::ECMAScript;
+        if (pattern->caseless) flags |= std::regex_constants::icase;
+        std::regex re(pattern->expression, flags);
+        
+        for (const std::string& line : lines) {
+            if (check(*pattern, re, line)) continue;
+            if (failures++ < 10) std::cout << "patterns: " << pattern->name << " differs from std::regex on '" << line << "'\n";
+        }
+        
+        TResult result;
+        result.pattern = pattern;
+        result.reference = time(runs, [&]() {
+            std::smatch match;
+            for (const std::string& line : lines) std::regex_search(line, match, re);
+        });
+        result.compiled = time(runs, [&]() {
+            Match match;
+            for (const std::string& line : lines) pattern->search(line, match);
+        });
+        results.push_back(result);
+    }
+    
+    double reference = 0, compiled = 0, logs = 0;
+    
+    printf("%-28s %12s %12s %9s\n", "pattern", "std::regex", "compiled", "speedup");
+    for (const TResult& result : results) {
+        printf("%-28s %10.0fns %10.0fns %8.1fx\n", result.pattern->name.c_str(),
+               result.reference * 1e9 / lines.size(), result.compiled * 1e9 / lines.size(), result.reference / result.compiled);
+        reference += result.reference;
+        compiled += result.compiled;
+        logs += std::log(result.reference / result.compiled);
+    }
+    printf("%-28s %10.0fns %10.0fns %8.1fx\n", "total", reference * 1e9 / lines.size(), compiled * 1e9 / lines.size(), reference / compiled);
+    printf("%ld lines, geometric mean speedup %.1fx\n", lines.size(), std::exp(logs / results.size()));
+    
+    if (failures) {
+        std::cout << "patterns: " << failures << " results differ from std::regex\n";
+        return 1;
+    }
+    return 0;
+}
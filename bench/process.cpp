@@ -0,0 +1,83 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "process.hpp"
+
+#include <sstream>
+#include <cstdio>
+
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+int run(const std::vector<std::string>& arguments, std::string& output, long& peakRSS) {
+    int fd[2];
+    if (pipe(fd) != 0) return -1;
+    
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    
+    if (pid == 0) {
+        std::vector<char *> argv;
+        for (const auto& argument : arguments) argv.push_back(const_cast<char *>(argument.c_str()));
+        argv.push_back(nullptr);
+        
+        dup2(fd[1], STDOUT_FILENO);
+        dup2(fd[1], STDERR_FILENO);
+        close(fd[0]);
+        close(fd[1]);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    
+    close(fd[1]);
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fd[0], buffer, sizeof(buffer))) > 0) {
+        output.append(buffer, n);
+    }
+    close(fd[0]);
+    
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0) return -1;
+    
+#ifdef __APPLE__
+    peakRSS = usage.ru_maxrss / 1024;
+#else
+    peakRSS = usage.ru_maxrss;
+#endif
+    
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+long compiledLines(const std::string& output) {
+    size_t position = output.find("Compiled in ");
+    if (position == std::string::npos) return 0;
+    
+    double seconds;
+    long lines;
+    if (sscanf(output.c_str() + position, "Compiled in %lf seconds (%ld lines", &seconds, &lines) != 2) return 0;
+    return lines;
+}
@@ -22,46 +22,22 @@
  SOFTWARE.
  */
 
+#ifndef PROCESS_HPP
+#define PROCESS_HPP
 
-#include "singleton.hpp"
+#include <string>
+#include <vector>
 
-// Define the static Singleton pointer
-Singleton* Singleton::_shared = NULL;
-
-Singleton* Singleton::shared() {
-    if (_shared == NULL) {
-        _shared = new Singleton();
-    }
-    return(_shared);
-}
-
-void Singleton::incrementLineNumber(void) {
-    ++_currentline;
-}
-
-long Singleton::currentLineNumber(void) {
-    return _currentline;
-}
-
-std::string Singleton::currentPathname(void) {
-    if (_pathnames.empty()) return "";
-    return _pathnames.back();
-}
+/*
+ Runs the program to completion, capturing both its standard output and standard error, and
+ returns its exit status, or -1 should it fail to run, along with the peak resident set size
+ in kilobytes.
+ */
+int run(const std::vector<std::string>& arguments, std::string& output, long& peakRSS);
 
-std::string Singleton::getPath(void) {
-    std::string pathname = _pathnames.front();
-    if (pathname.empty()) return "";
-    pathname.resize(pathname.rfind('/') + 1);
-    return pathname;
-}
+/*
+ Picks the number of lines compiled out of the "Compiled in ..." line reported by the compiler.
+ */
+long compiledLines(const std::string& output);
 
-void Singleton::pushPathname(const std::string& pathname) {
-    _pathnames.push_back(pathname);
-    _lines.push_back(_currentline);
-    _currentline = 1;
-}
-void Singleton::popPathname(void) {
-    _currentline = _lines.back();
-    _pathnames.pop_back();
-    _lines.pop_back();
-}
+#endif /* PROCESS_HPP */
@@ -0,0 +1,203 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+/*
+ Compiles synthetic programs of growing size along each dimension that is known to be prone to
+ superlinear behaviour, fits the growth of the compile time against the size and fails should
+ any dimension grow faster than O(n log n).
+ 
+ Usage: scaling [-p <compiler>] [-g <generator>] [-d <directory>] [-r <runs>] [-t <tolerance>]
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "process.hpp"
+
+typedef struct TDimension {
+    const char *name;
+    const char *knob;                       // the generator option that is varied
+    std::vector<int> sizes;
+    std::vector<std::string> arguments;     // the generator options that are held fixed
+    bool lines;                             // the size is measured in lines compiled rather than the knob
+} TDimension;
+
+typedef struct TPoint {
+    double n;
+    double seconds;
+} TPoint;
+
+static const TDimension _dimensions[] = {
+    // Roughly 1k, 10k and 100k lines.
+    {"lines", "-functions", {28, 280, 2800}, {"-defines", "100"}, true},
+    {"defines", "-defines", {10, 100, 1000, 10000}, {"-functions", "20"}, false}
+};
+
+static std::string _compiler = "bin/p+";
+static std::string _generator = "bin/generate";
+static std::string _directory = "/tmp/p+scaling";
+static int _runs = 3;
+
+// MARK: - Measuring
+
+// Returns the fastest of the runs in seconds, or a negative value should the program fail to compile.
+static double measure(const std::vector<std::string>& arguments, long& lines) {
+    std::string path = _directory + "/program";
+    std::string output;
+    long peakRSS;
+    
+    std::vector<std::string> generate = {_generator, "-o", path};
+    generate.insert(generate.end(), arguments.begin(), arguments.end());
+    if (run(generate, output, peakRSS) != 0) {
+        std::cout << "scaling: unable to generate program\n" << output;
+        return -1;
+    }
+    
+    double best = -1;
+    for (int r = 0; r < _runs; ++r) {
+        output.clear();
+        
+        auto start = std::chrono::steady_clock::now();
+        int status = run({_compiler, path + "/main.c", "-o", path + "/main.hpprgm", "-l", path}, output, peakRSS);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        lines = compiledLines(output);
+        if (status != 0 || lines == 0) {
+            std::cout << "scaling: program failed to compile\n" << output;
+            return -1;
+        }
+        if (best < 0 || seconds < best) best = seconds;
+    }
+    
+    return best;
+}
+
+// MARK: - Fitting
+
+/*
+ The exponent k of the best fit of t = c·n^k, found by least squares on log t against log n.
+ */
+static double fitExponent(const std::vector<TPoint>& points) {
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    double count = points.size();
+    
+    for (const auto& point : points) {
+        double x = std::log(point.n);
+        double y = std::log(point.seconds);
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    
+    return (count * sxy - sx * sy) / (count * sxx - sx * sx);
+}
+
+/*
+ The exponent n log n itself has over the range measured, as over any finite range it
+ looks a little steeper than n.
+ */
+static double nLogNExponent(double first, double last) {
+    return 1.0 + std::log(std::log(last) / std::log(first)) / std::log(last / first);
+}
+
+// MARK: - Main
+
+static void usage(void) {
+    std::cout << "Usage: scaling [-p <compiler>] [-g <generator>] [-d <directory>] [-r <runs>] [-t <tolerance>]\n";
+}
+
+int main(int argc, char **argv) {
+    double tolerance = 0.15;
+    
+    for (int n = 1; n < argc; n++) {
+        std::string args = argv[n];
+        
+        if (n + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        
+        if (args == "-p") _compiler = argv[++n];
+        else if (args == "-g") _generator = argv[++n];
+        else if (args == "-d") _directory = argv[++n];
+        else if (args == "-r") _runs = std::max(1, atoi(argv[++n]));
+        else if (args == "-t") tolerance = atof(argv[++n]);
+        else {
+            usage();
+            return 1;
+        }
+    }
+    
+    // The cost of starting the compiler at all is taken off every measurement.
+    long lines;
+    double startup = measure({"-functions", "0", "-defines", "0", "-includes", "0"}, lines);
+    if (startup < 0) return 1;
+    
+    bool failed = false;
+    
+    for (const auto& dimension : _dimensions) {
+        std::vector<TPoint> points;
+        
+        printf("%s\n", dimension.name);
+        for (int size : dimension.sizes) {
+            std::vector<std::string> arguments = dimension.arguments;
+            arguments.push_back(dimension.knob);
+            arguments.push_back(std::to_string(size));
+            
+            double seconds = measure(arguments, lines);
+            if (seconds < 0) return 1;
+            
+            double n = dimension.lines ? lines : size;
+            printf("%12.0f %10.3f s\n", n, seconds);
+            
+            points.push_back({n, std::max(seconds - startup, 0.001)});
+        }
+        
+        // Sizes more than two orders of magnitude below the largest are dominated by fixed costs.
+        double largest = points.back().n;
+        std::erase_if(points, [largest](const TPoint& point) { return point.n * 100 < largest; });
+        
+        double exponent = fitExponent(points);
+        double bound = nLogNExponent(points.front().n, points.back().n) + tolerance;
+        bool superlinear = exponent > bound;
+        
+        printf("%s grows as n^%.2f, the bound being n^%.2f%s\n\n", dimension.name, exponent, bound, superlinear ? " ❌" : "");
+        if (superlinear) failed = true;
+    }
+    
+    if (failed) {
+        std::cout << "scaling: compile time grows faster than O(n log n)\n";
+        return 1;
+    }
+    
+    return 0;
+}
@@ -26,26 +26,83 @@
 #include "aliases.hpp"
 #include "common.hpp"
 
-#include "singleton.hpp"
+#include "context.hpp"
+#include "patterns.hpp"
+#include "lexer.hpp"
 #include <regex>
+#include <algorithm>
 #include <sstream>
 
 using namespace pp;
 
-bool compareInterval(Aliases::TIdentity i1, Aliases::TIdentity i2) {
-    return (i1.identifier.length() > i2.identifier.length());
+/*
+ Parses the body of a function-like macro once, when it's defined, into the body with its
+ parameters taken out and a slot for every place an argument is to be inserted. A parameter
+ is referred to either by name or by position, eg. `$1` for the first parameter.
+ */
+static void compileMacro(Aliases::TIdentity& identity) {
+    std::vector<std::string> parameters;
+    for (auto it = Patterns::CommaSeparated.iterator(identity.parameters); it != MatchIterator(); ++it) {
+        parameters.push_back(it->str());
+    }
+    
+    identity.arity = parameters.size();
+    identity.body.clear();
+    identity.slots.clear();
+    
+    std::vector<Lexer::TToken> tokens = Lexer::tokenize(identity.real);
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        const Lexer::TToken& token = tokens[i];
+        size_t parameter = identity.arity;
+        
+        if (Lexer::Type::Identifier == token.type) {
+            for (parameter = 0; parameter < identity.arity; ++parameter) {
+                if (parameters[parameter] == token.text) break;
+            }
+        }
+        
+        if (token.text == "$" && i + 1 < tokens.size() && Lexer::Type::Number == tokens[i + 1].type) {
+            const std::string& digits = tokens[i + 1].text;
+            if (digits.find_first_not_of("0123456789") == std::string::npos) {
+                size_t n = std::stoul(digits);
+                if (n >= 1 && n <= identity.arity) {
+                    parameter = n - 1;
+                    i++;
+                }
+            }
+        }
+        
+        if (parameter == identity.arity) {
+            identity.body.append(token.text);
+            continue;
+        }
+        identity.slots.push_back({identity.body.length(), parameter});
+    }
+}
+
+static std::string expandMacro(const Aliases::TIdentity& identity, const std::vector<std::string>& arguments) {
+    std::string result;
+    size_t offset = 0;
+    
+    for (const auto& slot : identity.slots) {
+        result.append(identity.body, offset, slot.offset - offset);
+        result.append(arguments.at(slot.parameter));
+        offset = slot.offset;
+    }
+    result.append(identity.body, offset, std::string::npos);
+    
+    return result;
 }
 
 bool Aliases::append(const TIdentity& idty) {
     TIdentity identity = idty;
-    Singleton *singleton = Singleton::shared();
     
     if (identity.identifier.empty()) return false;
     
     trim(identity.identifier);
     trim(identity.real);
-    identity.pathname = singleton->currentPathname();
-    identity.line = singleton->currentLineNumber();
+    identity.pathname = _context.currentPathname();
+    identity.line = _context.currentLineNumber();
     
     if (!identity.message.empty()) {
         trim(identity.message);
@@ -53,7 +110,7 @@ bool Aliases::append(const TIdentity& idty) {
     }
     
     if (Scope::Auto == identity.scope) {
-        identity.scope = singleton->scope == Singleton::Scope::Global ? Aliases::Scope::Global : Aliases::Scope::Local;
+        identity.scope = _context.scope == Context::Scope::Global ? Aliases::Scope::Global : Aliases::Scope::Local;
     }
     
     if ('_' == identity.identifier.at(0) && '_' != identity.identifier.at(1)) {
@@ -61,30 +118,40 @@ bool Aliases::append(const TIdentity& idty) {
         identity.type = Type::Property;
     }
     
-    if (exists(identity) == true) {
-        for (const auto &it : _identities) {
-            if (it.identifier == identity.identifier) {
-                std::cout
-                << MessageType::Warning
-                << "redefinition of: \e[1;97m" << identity.identifier << "\e[0;m, ";
-                if (basename(Singleton::shared()->currentPathname()) == basename(it.pathname)) {
-                    std::cout << "previous definition on line " << it.line << "\n";
-                }
-                else {
-                    std::cout << "previous definition in " << ANSI::Green << basename(it.pathname) << ANSI::Default << " on line " << it.line << "\n";
-                }
-                break;
-            }
+    const TIdentity *previous = find(identity.identifier);
+    if (previous) {
+        _context.log
+        << MessageType::Warning
+        << "redefinition of: \e[1;97m" << identity.identifier << "\e[0;m, ";
+        if (basename(_context.currentPathname()) == basename(previous->pathname)) {
+            _context.log << "previous definition on line " << previous->line << "\n";
+        }
+        else {
+            _context.log << "previous definition in " << ANSI::Green << basename(previous->pathname) << ANSI::Default << " on line " << previous->line << "\n";
         }
         return false;
     }
     
-    _identities.push_back(identity);
+    if (!identity.parameters.empty()) {
+        compileMacro(identity);
+    }
+    
+    if (Scope::Local == identity.scope && _generations.size() == 1) {
+        _generations.emplace_back();
+    }
+    
+    const std::string& identifier = identity.identifier;
+    if ('`' == identifier.at(0) && '`' == identifier.at(identifier.length() - 1)) {
+        auto it = _patterns.begin();
+        while (it != _patterns.end() && it->length() >= identifier.length()) it++;
+        _patterns.insert(it, identifier);
+    }
     
-    // Resort in descending order
-    std::sort(_identities.begin(), _identities.end(), compareInterval);
+    TGeneration& generation = Scope::Local == identity.scope ? _generations.back() : _generations.front();
+    generation.emplace(identifier, identity);
+    _generation++;
     
-    if (verbose) std::cout
+    if (verbose) _context.log
         << MessageType::Verbose
         << (Scope::Local == identity.scope && Type::Macro != identity.type ? ANSI::Default + ANSI::Bold + "local" + ANSI::Default + ":" : "")
         << (Scope::Global == identity.scope && Type::Macro != identity.type ? ANSI::Yellow + "global" + ANSI::Default + ":" : "")
@@ -98,187 +165,272 @@ bool Aliases::append(const TIdentity& idty) {
 }
 
 void Aliases::removeAllLocalAliases() {
-    for (auto it = _identities.begin(); it != _identities.end(); ++it) {
-        if (it->scope == Scope::Local) {
-            if (verbose) std::cout
+    while (_generations.size() > 1) {
+        for (const auto& entry : _generations.back()) {
+            const TIdentity& identity = entry.second;
+            if (verbose) _context.log
                 << MessageType::Verbose
                 << ANSI::Default << ANSI::Bold << "local" << ANSI::Default << ":"
-                << (Type::Eenum == it->type ? " enumerator" : "")
-                << (Type::Struct == it->type ? " structure" : "")
-                << (Type::Def == it->type ? " def" : "")
-                << (Type::Member == it->type ? " identifier" : "")
-                << (Type::Unknown == it->type ? " identifier" : "")
-                << " " << ANSI::Green << it->identifier << ANSI::Default << " removed❗\n";
-            _identities.erase(it);
-            removeAllLocalAliases();
-            break;
+                << (Type::Eenum == identity.type ? " enumerator" : "")
+                << (Type::Struct == identity.type ? " structure" : "")
+                << (Type::Def == identity.type ? " def" : "")
+                << (Type::Member == identity.type ? " identifier" : "")
+                << (Type::Unknown == identity.type ? " identifier" : "")
+                << " " << ANSI::Green << identity.identifier << ANSI::Default << " removed❗\n";
+            removePattern(identity.identifier);
         }
+        _generations.pop_back();
+        _generation++;
     }
     
-    while (_namespaseCheckpoint != _namespaces.size()) {
+    if (_namespaseCheckpoint != _namespaces.size()) {
         _namespaces.resize(_namespaseCheckpoint);
+        _generation++;
     }
 }
 
 void Aliases::removeAllAliasesOfType(const Type type) {
-    for (auto it = _identities.begin(); it != _identities.end(); ++it) {
-        if (it->type == type) {
-            if (verbose) std::cout
+    for (auto& generation : _generations) {
+        for (auto it = generation.begin(); it != generation.end(); ) {
+            if (it->second.type != type) {
+                it++;
+                continue;
+            }
+            
+            const TIdentity& identity = it->second;
+            if (verbose) _context.log
                 << MessageType::Verbose
-                << (Scope::Local == it->scope && Type::Macro != it->type ? ANSI::Default + ANSI::Bold + "local" + ANSI::Default + ": " : "")
-                << (Scope::Global == it->scope && Type::Macro != it->type ? ANSI::Yellow + "global" + ANSI::Default + ": " : "")
-                << (Type::Macro == it->type ? "macro" : "")
-                << (Type::Eenum == it->type ? "enumerator" : "")
-                << (Type::Struct == it->type ? "structure" : "")
-                << (Type::Def == it->type ? " def" : "")
-                << (Type::Member == it->type ? "identifier" : "")
-                << (Type::Unknown == it->type ? "identifier" : "")
-                << " " << ANSI::Green << it->identifier << ANSI::Default << " removed❗\n";
-            _identities.erase(it);
-            removeAllAliasesOfType(type);
-            break;
+                << (Scope::Local == identity.scope && Type::Macro != identity.type ? ANSI::Default + ANSI::Bold + "local" + ANSI::Default + ": " : "")
+                << (Scope::Global == identity.scope && Type::Macro != identity.type ? ANSI::Yellow + "global" + ANSI::Default + ": " : "")
+                << (Type::Macro == identity.type ? "macro" : "")
+                << (Type::Eenum == identity.type ? "enumerator" : "")
+                << (Type::Struct == identity.type ? "structure" : "")
+                << (Type::Def == identity.type ? " def" : "")
+                << (Type::Member == identity.type ? "identifier" : "")
+                << (Type::Unknown == identity.type ? "identifier" : "")
+                << " " << ANSI::Green << identity.identifier << ANSI::Default << " removed❗\n";
+            removePattern(identity.identifier);
+            it = generation.erase(it);
+            _generation++;
         }
     }
 }
 
-static std::string resolveMacroFunction(const std::string& str, const std::string& parameters, const std::string& identifier, const std::string& real) {
-    std::string result;
-    std::regex re;
-    std::smatch match;
-    std::string pattern;
+Aliases::TIdentity *Aliases::find(const std::string& identifier) {
+    for (auto generation = _generations.rbegin(); generation != _generations.rend(); ++generation) {
+        auto it = generation->find(identifier);
+        if (it != generation->end()) return &it->second;
+    }
+    return nullptr;
+}
+
+/*
+ Looks up an identity by the name it's used by, an identity defined within a namespace
+ being found by its plain name as well as by its qualified one.
+ */
+const Aliases::TIdentity *Aliases::lookup(const std::string& name) {
+    for (const auto& ns : _namespaces) {
+        const TIdentity *identity = find(ns + "::" + name);
+        if (identity) return identity;
+    }
+    return find(name);
+}
+
+void Aliases::removePattern(const std::string& identifier) {
+    for (auto it = _patterns.begin(); it != _patterns.end(); ++it) {
+        if (*it != identifier) continue;
+        _patterns.erase(it);
+        break;
+    }
+}
+
+bool Aliases::isNamespace(const std::string& name) {
+    for (const auto& ns : _namespaces) {
+        if (ns == name) return true;
+    }
+    return false;
+}
+
+/*
+ Splits the arguments of a macro call that starts with the opening parenthesis at `position`
+ on the commas that aren't nested within any brackets, returning the index one past the closing
+ parenthesis, or 0 if the tokens at `position` aren't a complete call.
+ */
+static size_t splitMacroArguments(const std::vector<Lexer::TToken>& tokens, size_t position, std::vector<std::string>& arguments) {
+    if (position >= tokens.size() || tokens[position].text != "(") return 0;
     
-    re = R"(\b)" + identifier + R"(\(([^()]*)\))";
-    if (std::regex_search(str, match, re)) {
-        result = match[1].str();
+    std::string argument;
+    int depth = 0;
+    arguments.clear();
+    
+    for (size_t i = position + 1; i < tokens.size(); ++i) {
+        const std::string& text = tokens[i].text;
         
-        re = R"([^,]+(?=[^,]*))";
-        std::vector<std::string> arguments;
-        for (auto it = std::sregex_iterator(result.begin(), result.end(), re); it != std::sregex_iterator(); ++it) {
-            arguments.push_back(it->str());
+        if (depth == 0 && (text == "," || text == ")")) {
+            if (text == "," || !arguments.empty() || !argument.empty()) arguments.push_back(argument);
+            if (text == ")") return i + 1;
+            argument.clear();
+            continue;
         }
         
-        result = real;
-        size_t i = 0;
-        for (auto it = std::sregex_iterator(parameters.begin(), parameters.end(), re); it != std::sregex_iterator(); ++it, ++i) {
-            if (arguments.empty()) {
-                std::cout << MessageType::Error << ANSI::Red << "macro parameters mismatched" << ANSI::Default << '\n';
-                break;
-            }
-            
-            pattern = "\\b" + it->str() + "\\b";
-            result = std::regex_replace(result, std::regex(pattern), arguments.at(i));
-            
-            pattern = "\\$" + std::to_string(i + 1);
-            result = std::regex_replace(result, std::regex(pattern), arguments.at(i));
-        }
+        if (text == "(" || text == "[" || text == "{") depth++;
+        if (text == ")" || text == "]" || text == "}") depth--;
+        argument.append(text);
     }
-    
-    return result;
+    return 0;
 }
 
-std::string Aliases::resolveAllAliasesInText(const std::string& str) {
-    std::string s = str;
-    std::regex re;
-    std::smatch match;
-    std::string namespaces, pattern;
+std::string Aliases::resolveAliases(const std::string& str, const std::vector<const TIdentity *>& inherited) {
+    typedef struct TExpansion {
+        const TIdentity *identity;
+        size_t end;             // index one past the last token produced by this expansion
+    } TExpansion;
     
-    if (s.empty()) return s;
+    std::vector<Lexer::TToken> tokens = Lexer::tokenize(str);
+    std::vector<TExpansion> expanding;
+    std::vector<std::string> arguments;
     
-    namespaces = "((";
-    for (auto it = _namespaces.begin(); it != _namespaces.end(); ++it) {
-        if (it != _namespaces.begin()) {
-            namespaces += "|";
+    /*
+     The line is scanned once, from left to right. When an identifier turns out to be an alias,
+     its tokens are replaced in place by the tokens of what it stands for and scanning carries
+     on from the first of the new tokens, so aliases referring to other aliases get resolved too.
+     
+     Every alias being resolved is kept on the expansion stack until the scan moves past the
+     tokens it produced. An alias that is still on the stack is never resolved again, so an
+     alias that refers to itself can't recurse forever.
+     
+     As in C, the arguments of a macro call are resolved on their own before being substituted,
+     with every alias being resolved at that point still treated as active.
+     */
+    for (size_t i = 0; i < tokens.size(); ) {
+        while (!expanding.empty() && expanding.back().end <= i) expanding.pop_back();
+        
+        if (Lexer::Type::Identifier != tokens[i].type && Lexer::Type::Directive != tokens[i].type) {
+            i++;
+            continue;
+        }
+        
+        size_t first = i, last = i + 1;
+        std::string name = tokens[i].text;
+        if (Lexer::Type::Directive == tokens[i].type) name.erase(0, 1);
+        
+        // An optional namespace qualifier, eg. `ns::name`
+        if (last + 1 < tokens.size() && tokens[last].text == "::" && Lexer::Type::Identifier == tokens[last + 1].type && isNamespace(name)) {
+            name = tokens[last + 1].text;
+            last += 2;
+        }
+        
+        const TIdentity *entry = lookup(name);
+        if (!entry) {
+            i = last;
+            continue;
+        }
+        
+        const TIdentity& identity = *entry;
+        bool active = std::find(inherited.begin(), inherited.end(), entry) != inherited.end();
+        for (const auto& expansion : expanding) {
+            if (expansion.identity == entry) active = true;
+        }
+        if (active) {
+            i = last;
+            continue;
         }
-        namespaces += *it;
-    }
-    namespaces += ")::)";
         
-    for (auto it = _identities.begin(); it != _identities.end(); ++it) {
-        if ('`' == it->identifier.at(0) && '`' == it->identifier.at(it->identifier.length() - 1)) {
-            pattern = it->identifier;
-        } else {
-            if (_namespaces.size()) {
-                pattern = R"(\b)" + namespaces + "?" + regex_replace(it->identifier, std::regex(namespaces), "") + R"(\b)";
+        std::string real = identity.real;
+        if (!identity.parameters.empty()) {
+            size_t end = splitMacroArguments(tokens, last, arguments);
+            if (!end) {
+                i = last;
+                continue;
             }
-            else {
-                pattern = R"(\b)" + it->identifier + R"(\b)";
+            
+            if (arguments.size() != identity.arity) {
+                _context.log << MessageType::Error << ANSI::Red << "macro parameters mismatched" << ANSI::Default << '\n';
+                i = end;
+                continue;
             }
+            
+            std::vector<const TIdentity *> active = inherited;
+            for (const auto& expansion : expanding) active.push_back(expansion.identity);
+            for (auto& argument : arguments) argument = resolveAliases(argument, active);
+            
+            real = expandMacro(identity, arguments);
+            last = end;
         }
         
-        re = pattern;
-
-        if (!it->parameters.empty()) {
-            re = R"(\b)" + namespaces + "?" + it->identifier + R"(\([^()]*\))";
-            while (regex_search(s, match, re)) {
-                if (it->deprecated) std::cout << MessageType::Deprecated << it->identifier << it->message << "\n";
-                std::string result = resolveMacroFunction(match.str(), it->parameters, it->identifier, it->real);
-                s.replace(match.position(), match.length(), result);
-            }
-            continue;
+        if (identity.deprecated) _context.log << MessageType::Deprecated << identity.identifier << identity.message << "\n";
+        
+        if (Lexer::Type::Directive == tokens[first].type) real.insert(0, "#");
+        
+        std::vector<Lexer::TToken> replacement = Lexer::tokenize(real);
+        long delta = (long)replacement.size() - (long)(last - first);
+        for (auto& expansion : expanding) {
+            expansion.end = expansion.end >= last ? expansion.end + delta : first + replacement.size();
         }
         
-        if (regex_search(s, re) && it->deprecated)
-            std::cout << MessageType::Deprecated << it->identifier << it->message << "\n";
-        s = regex_replace(s, re, it->real);
+        tokens.erase(tokens.begin() + first, tokens.begin() + last);
+        tokens.insert(tokens.begin() + first, replacement.begin(), replacement.end());
+        expanding.push_back({entry, first + replacement.size()});
     }
     
-    //TODO: Rework to remove this hack!
-    /*
-     To ensures proper resolution in cases where one alias refers to another.
-     It nessasary to perform another check, only if the first check was an alias.
-     */
-    if (s != str) {
-        s = resolveAllAliasesInText(s);
+    return Lexer::join(tokens);
+}
+
+std::string Aliases::resolveAllAliasesInText(const std::string& str) {
+    if (str.empty()) return str;
+    if (_generations.size() == 1 && _generations.front().empty()) return str;
+    
+    std::string s = resolveAliases(str, {});
+    
+    for (const auto& identifier : _patterns) {
+        const TIdentity& identity = *find(identifier);
+        std::regex re(identity.identifier);
+        
+        if (identity.deprecated && std::regex_search(s, re))
+            _context.log << MessageType::Deprecated << identity.identifier << identity.message << "\n";
+        s = std::regex_replace(s, re, identity.real);
     }
     
     return s;
 }
 
 void Aliases::remove(const std::string& identifier) {
-    for (auto it = _identities.begin(); it != _identities.end(); ++it) {
-        if (it->identifier == identifier) {
-            if (verbose) std::cout
-                << MessageType::Verbose
-                << (Scope::Local == it->scope && Type::Macro != it->type ? ANSI::Default + ANSI::Bold + "local" + ANSI::Default + ": " : "")
-                << (Scope::Global == it->scope && Type::Macro != it->type ? ANSI::Yellow + "global" + ANSI::Default + ": " : "")
-                << (Type::Macro == it->type ? "macro" : "")
-                << (Type::Eenum == it->type ? "enumerator" : "")
-                << (Type::Struct == it->type ? "structure" : "")
-                << (Type::Def == it->type ? "def" : "")
-                << (Type::Member == it->type ? "identifier" : "")
-                << (Type::Unknown == it->type ? "identifier" : "")
-                << " " << ANSI::Green << it->identifier << ANSI::Default << " removed❗\n";
-            
-            _identities.erase(it);
-            break;
-        }
+    for (auto generation = _generations.rbegin(); generation != _generations.rend(); ++generation) {
+        auto it = generation->find(identifier);
+        if (it == generation->end()) continue;
+        
+        const TIdentity& identity = it->second;
+        if (verbose) _context.log
+            << MessageType::Verbose
+            << (Scope::Local == identity.scope && Type::Macro != identity.type ? ANSI::Default + ANSI::Bold + "local" + ANSI::Default + ": " : "")
+            << (Scope::Global == identity.scope && Type::Macro != identity.type ? ANSI::Yellow + "global" + ANSI::Default + ": " : "")
+            << (Type::Macro == identity.type ? "macro" : "")
+            << (Type::Eenum == identity.type ? "enumerator" : "")
+            << (Type::Struct == identity.type ? "structure" : "")
+            << (Type::Def == identity.type ? "def" : "")
+            << (Type::Member == identity.type ? "identifier" : "")
+            << (Type::Unknown == identity.type ? "identifier" : "")
+            << " " << ANSI::Green << identity.identifier << ANSI::Default << " removed❗\n";
+        
+        removePattern(identifier);
+        generation->erase(it);
+        _generation++;
+        break;
     }
 }
 
 bool Aliases::exists(const TIdentity& identity) {
-    for (auto it = _identities.begin(); it != _identities.end(); ++it) {
-        if (it->identifier == identity.identifier) {
-            return true;
-        }
-    }
-    
-    return false;
+    return find(identity.identifier) != nullptr;
 }
 
 bool Aliases::identifierExists(const std::string& identifier) {
-    for (auto it = _identities.begin(); it != _identities.end(); ++it) {
-        if (it->identifier == identifier) {
-            return true;
-        }
-    }
-    
-    return false;
+    return find(identifier) != nullptr;
 }
 
 bool Aliases::realExists(const std::string& real) {
-    for (auto it = _identities.begin(); it != _identities.end(); ++it) {
-        if (it->real == real) {
-            return true;
+    for (const auto& generation : _generations) {
+        for (const auto& entry : generation) {
+            if (entry.second.real == real) return true;
         }
     }
     
@@ -286,20 +438,16 @@ bool Aliases::realExists(const std::string& real) {
 }
 
 void Aliases::dumpIdentities() {
-    for (auto it = _identities.begin(); it != _identities.end(); ++it) {
-        if (verbose) std::cout << "_identities : " << it->identifier << " = " << it->real << "\n";
+    for (const auto& generation : _generations) {
+        for (const auto& entry : generation) {
+            if (verbose) _context.log << "_identities : " << entry.second.identifier << " = " << entry.second.real << "\n";
+        }
     }
 }
 
 Aliases::TIdentity Aliases::getIdentity(const std::string& identifier) {
-    TIdentity identity;
-    for (auto it = _identities.begin(); it != _identities.end(); ++it) {
-        if (it->identifier == identifier) {
-            memcpy(&identity, &*it, sizeof(TIdentity));
-            break;
-        }
-    }
-    return identity;
+    const TIdentity *identity = find(identifier);
+    return identity ? *identity : TIdentity();
 }
 
 //MARK: - namespace
@@ -309,8 +457,9 @@ void Aliases::addNamespace(const std::string& name) {
         if (name == *it) return;
     }
     _namespaces.push_back(name);
+    _generation++;
     
-    if (Singleton::shared()->scope == Singleton::Scope::Global) {
+    if (_context.scope == Context::Scope::Global) {
         _namespaseCheckpoint = _namespaces.size();
     }
 }
@@ -320,6 +469,7 @@ void Aliases::removeNamespace(const std::string& name) {
     for (auto it = _namespaces.begin(); it != _namespaces.end(); ++it, ++index) {
         if (name != *it) continue;
         _namespaces.erase(it);
+        _generation++;
         if (index < _namespaseCheckpoint) _namespaseCheckpoint--;
         break;
     }
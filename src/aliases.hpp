@@ -29,9 +29,12 @@
 #include <iostream>
 #include <list>
 #include <vector>
+#include <unordered_map>
 #include <stdint.h>
 
 namespace pp {
+    class Context;
+    
     class Aliases {
     public:
         enum class Type {
@@ -53,10 +56,18 @@ namespace pp {
             Local  = 2
         };
         
+        typedef struct TSlot {
+            size_t offset;          // offset within the macro body the argument goes at
+            size_t parameter;       // index of the parameter whose argument goes there
+        } TSlot;
+        
         typedef struct TIdentity {
             std::string identifier;
             std::string real;
             std::string parameters; // used by macros
+            std::string body;       // used by macros, real with the parameters taken out
+            std::vector<TSlot> slots;
+            size_t arity = 0;
             Type type;
             Scope scope;
             long line;              // line that definition accoured;
@@ -68,6 +79,13 @@ namespace pp {
         
         bool verbose = false;
         
+        Aliases(Context& context) : _context(context) {}
+        
+        // Changes whenever any identity or namespace is added or removed.
+        uint64_t generation(void) const {
+            return _generation;
+        }
+        
         bool append(const TIdentity& identity);
         void removeAllLocalAliases();
         void removeAllAliasesOfType(const Type type);
@@ -84,10 +102,31 @@ namespace pp {
         void removeNamespace(const std::string& name);
         
     private:
-        std::vector<TIdentity> _identities;
+        Context& _context;
+        
+        /*
+         Identities are kept in stacked generations, the global generation at the bottom and a
+         local generation pushed on top for the first local identity of a function. Each
+         generation is hashed by identifier, so lookups and inserts don't depend on how many
+         identities there are, and leaving a function drops its whole generation at once.
+         */
+        typedef std::unordered_map<std::string, TIdentity> TGeneration;
+        std::vector<TGeneration> _generations = std::vector<TGeneration>(1);
+        
+        // Identifiers enclosed in backticks are regular expressions, longest first.
+        std::vector<std::string> _patterns;
+        
         std::vector<std::string> _namespaces;
         size_t _namespaseCheckpoint = _namespaces.size();
         
+        uint64_t _generation = 0;
+        
+        TIdentity *find(const std::string& identifier);
+        const TIdentity *lookup(const std::string& name);
+        bool isNamespace(const std::string& name);
+        std::string resolveAliases(const std::string& str, const std::vector<const TIdentity *>& inherited);
+        void removePattern(const std::string& identifier);
+        
     };
 }
 #endif // ALIASES_HPP
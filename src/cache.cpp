@@ -0,0 +1,155 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#include "cache.hpp"
+#include "source.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <thread>
+#include <unistd.h>
+
+using namespace pp;
+
+static bool hashFile(const std::string& pathname, uint64_t& hash) {
+    Source source;
+    if (!source.open(pathname)) return false;
+    hash = Cache::hash(source.contents());
+    return true;
+}
+
+Cache::Cache(const std::string& directory) : directory(directory) {
+    if (!this->directory.empty() && this->directory.back() != '/') this->directory.append("/");
+    
+    std::error_code error;
+    std::filesystem::create_directories(this->directory, error);
+}
+
+uint64_t Cache::hash(std::string_view data, uint64_t hash) {
+    for (const unsigned char c : data) {
+        hash ^= c;
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+uint64_t Cache::manifestKey(const std::string& pathname, const std::string& settings, uint64_t contents) {
+    uint64_t key = hash(settings);
+    key = hash(pathname, hash(std::string_view("\0", 1), key));
+    return hash(std::string_view((const char *)&contents, sizeof(contents)), key);
+}
+
+uint64_t Cache::programKey(uint64_t manifest, const std::vector<TDependency>& dependencies) {
+    uint64_t key = manifest;
+    for (const auto& dependency : dependencies) {
+        key = hash(std::string_view((const char *)&dependency.hash, sizeof(dependency.hash)), key);
+    }
+    return key;
+}
+
+std::string Cache::filename(uint64_t key, const std::string& extension) {
+    std::ostringstream os;
+    os << directory << std::hex << std::setw(16) << std::setfill('0') << key << extension;
+    return os.str();
+}
+
+/*
+ The data is written to a file of its own first and then renamed, so that a program being
+ compiled at the same time never sees a file that has only been partly written. The file is
+ named after both the process and the thread, as any number of compilers may share the cache.
+ */
+bool Cache::write(const std::string& filename, const std::string& data) {
+    std::ostringstream temporary;
+    temporary << filename << "." << getpid() << "." << std::this_thread::get_id() << ".tmp";
+    
+    std::ofstream outfile;
+    outfile.open(temporary.str(), std::ios::out | std::ios::binary);
+    if (!outfile.is_open()) return false;
+    outfile.write(data.data(), data.size());
+    outfile.close();
+    
+    std::error_code error;
+    if (outfile.fail()) {
+        std::filesystem::remove(temporary.str(), error);
+        return false;
+    }
+    std::filesystem::rename(temporary.str(), filename, error);
+    return !error;
+}
+
+bool Cache::lookup(const std::string& pathname, const std::string& settings, std::string& hpprgm) {
+    uint64_t contents;
+    if (!hashFile(pathname, contents)) return false;
+    
+    uint64_t manifest = manifestKey(pathname, settings, contents);
+    std::ifstream infile;
+    infile.open(filename(manifest, ".manifest"), std::ios::in);
+    if (!infile.is_open()) return false;
+    
+    /*
+     eg. 9ae16a3b2f90c4a7 lib/graphics.pplib
+     Each line holds the hash of a file the program was built from, followed by its pathname.
+     */
+    std::vector<TDependency> dependencies;
+    std::string line;
+    while (std::getline(infile, line)) {
+        if (line.length() < 18) return false;
+        
+        TDependency dependency;
+        dependency.pathname = line.substr(17);
+        if (!hashFile(dependency.pathname, dependency.hash)) return false;
+        if (dependency.hash != std::stoull(line.substr(0, 16), nullptr, 16)) return false;
+        dependencies.push_back(dependency);
+    }
+    infile.close();
+    
+    infile.open(filename(programKey(manifest, dependencies), ".hpprgm"), std::ios::in | std::ios::binary);
+    if (!infile.is_open()) return false;
+    
+    std::ostringstream os;
+    os << infile.rdbuf();
+    hpprgm = os.str();
+    return true;
+}
+
+void Cache::store(const std::string& pathname, const std::string& settings, const std::vector<TDependency>& dependencies, const std::string& hpprgm) {
+    uint64_t contents = 0;
+    for (const auto& dependency : dependencies) {
+        if (dependency.pathname == pathname) contents = dependency.hash;
+    }
+    
+    uint64_t manifest = manifestKey(pathname, settings, contents);
+    
+    std::ostringstream os;
+    for (const auto& dependency : dependencies) {
+        os << std::hex << std::setw(16) << std::setfill('0') << dependency.hash << " " << dependency.pathname << "\n";
+    }
+    
+    // The program goes first, a manifest must never refer to a program that isn't there.
+    if (!write(filename(programKey(manifest, dependencies), ".hpprgm"), hpprgm)) return;
+    write(filename(manifest, ".manifest"), os.str());
+}
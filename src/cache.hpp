@@ -0,0 +1,73 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+
+namespace pp {
+    /*
+     A persistent cache of compiled programs, kept in a directory of its own.
+     
+     Which files a program includes is only known once it has been compiled, so every
+     program has a manifest, keyed by the hash of its pathname, its contents and the
+     settings it was compiled with, listing the hash of every file it was built from.
+     Only when every one of those files still has the same contents is the compiled
+     program, stored under the hash of them all, used in place of compiling it again.
+     */
+    class Cache {
+    public:
+        typedef struct TDependency {
+            std::string pathname;
+            uint64_t hash;
+        } TDependency;
+        
+        std::string directory;
+        
+        Cache(const std::string& directory);
+        
+        // Looks up the compiled program for `pathname`, putting it in `hpprgm` when found.
+        bool lookup(const std::string& pathname, const std::string& settings, std::string& hpprgm);
+        
+        // Stores the compiled program for `pathname` along with every file it was built from.
+        void store(const std::string& pathname, const std::string& settings, const std::vector<TDependency>& dependencies, const std::string& hpprgm);
+        
+        // 64-bit FNV-1a hash
+        static uint64_t hash(std::string_view data, uint64_t hash = 0xcbf29ce484222325);
+        
+    private:
+        uint64_t manifestKey(const std::string& pathname, const std::string& settings, uint64_t contents);
+        uint64_t programKey(uint64_t manifest, const std::vector<TDependency>& dependencies);
+        std::string filename(uint64_t key, const std::string& extension);
+        bool write(const std::string& filename, const std::string& data);
+    };
+}
+
+#endif /* CACHE_HPP */
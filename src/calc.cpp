@@ -21,309 +21,365 @@
  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  SOFTWARE.
  */
-
-
 #include "calc.hpp"
 #include "common.hpp"
+#include "context.hpp"
 
-#include <regex>
 #include <vector>
-#include <stack>
-#include <sstream>
-#include <iomanip>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
 
 using namespace pp;
 
-static bool _verbose = false;
-
-// Function to check if a character is an operator
-static bool isOperator(char c) {
-    return (c == '+' || c == '-' || c == '*' || c == '/' || c == '%' || c == '^');
+// Diagnostics go to the program being compiled on this thread, or the line it is rewriting.
+static std::ostream& messages(void) {
+    Context *context = Context::current();
+    return context ? context->diagnostics() : std::cout;
 }
 
-static bool isExpresionValid(const std::string& expression) {
-    std::regex re;
-    
-    re = R"((?:[\d+\-*\/ πe%&|()]|pi|MOD)+)";
-    return regex_match(expression, re);
+// The largest magnitude below which every integer is exactly representable as a double.
+static const int64_t _exactLimit = int64_t(1) << 53;
+
+typedef Calc::TValue TValue;
+
+// MARK: - Expression Tree
+
+typedef struct TNode {
+    char op = 0;            // 0 for a value, 'n' for negation, or one of + - * / % & |
+    TValue value;
+    int lhs = -1;
+    int rhs = -1;
+} TNode;
+
+/*
+ A recursive-descent parser for the constant expressions that Calc folds, with the precedence
+ of C from lowest to highest:
+ 
+     expression := and ('|' and)*
+     and        := sum ('&' sum)*
+     sum        := product (('+' | '-') product)*
+     product    := unary (('*' | '/' | '%' | 'MOD') unary)*
+     unary      := '-' unary | primary
+     primary    := integer | ppl-integer | 'e' | 'pi' | 'π' | '(' expression ')'
+ 
+ Each rule returns the index of the node it built, or -1 should the text not be a constant
+ expression, which is then simply left as it is.
+ */
+typedef struct TParser {
+    const std::string& str;
+    size_t pos = 0;
+    std::vector<TNode> nodes;
+} TParser;
+
+static int parseExpression(TParser& parser);
+
+static int addNode(TParser& parser, char op, int lhs, int rhs) {
+    if (lhs < 0 || rhs < 0) return -1;
+    TNode node;
+    node.op = op;
+    node.lhs = lhs;
+    node.rhs = rhs;
+    parser.nodes.push_back(node);
+    return (int)parser.nodes.size() - 1;
 }
 
-// Function to get the precedence of an operator
-static int precedence(char op) {
-    if (op == '+' || op == '-') return 1;
-    if (op == '*' || op == '/' || op == '%') return 2;
-    if (op == '^') return 3;
-    return 0;
+static int addValue(TParser& parser, const TValue& value) {
+    TNode node;
+    node.value = value;
+    parser.nodes.push_back(node);
+    return (int)parser.nodes.size() - 1;
 }
 
-// Function to perform arithmetic operations
-static double applyOperator(const double a, const double b, const char op) {
-    switch (op) {
-        case '+': return a + b;
-        case '-': return a - b;
-        case '*': return a * b;
-        case '/':
-            if (b == 0) {
-                std::cout << MessageType::Error << "#[]: division by zero\n";
-                return 0;
-            }
-            return a / b;
-        case '%': return fmod(a,b) < 0 ? b + fmod(a,b) : fmod(a,b);
-        case '^': return pow(a, b);
-            
-        default:
-            std::cout << MessageType::Error << "#[]: unknown '" << op << "' operator\n";
-            return 0;
-    }
+static void skipSpaces(TParser& parser) {
+    while (parser.pos < parser.str.length() && parser.str[parser.pos] == ' ') parser.pos++;
 }
 
-static std::string separateExpression(const std::string& expression) {
-    std::stringstream separated;
-    for (size_t i = 0; i < expression.length(); ++i) {
-        if (expression[i] == '(' || expression[i] == ')' || expression[i] == '+' || expression[i] == '-' || expression[i] == '*' || expression[i] == '/' || expression[i] == '%' || expression[i] == '^') {
-            // Handle negative numbers (only if '-' is not preceded by a digit)
-            if (expression[i] == '-' && (i == 0 || !isdigit(expression[i - 1]))) {
-                separated << " " << expression[i];
-            } else {
-                separated << " " << expression[i] << " ";
-            }
-        } else {
-            separated << expression[i];
-        }
-    }
-    return separated.str();
+// Consumes the given token, a keyword only when it is not part of a longer word.
+static bool accept(TParser& parser, const char *token) {
+    skipSpaces(parser);
+    size_t length = strlen(token);
+    if (parser.str.compare(parser.pos, length, token) != 0) return false;
+    if (isalpha((unsigned char)token[0]) && parser.pos + length < parser.str.length() && isalnum((unsigned char)parser.str[parser.pos + length])) return false;
+    parser.pos += length;
+    return true;
 }
 
-// Function to convert infix expression to postfix (RPN)
-static std::vector<std::string> infixToPostfix(const std::string& expression) {
-    std::vector<std::string> output;
-    std::stack<char> operators;
+static int parsePrimary(TParser& parser) {
+    TValue value;
     
-    std::regex re(R"([^ ]+)");
-    for(auto it = std::sregex_iterator(expression.begin(), expression.end(), re); it != std::sregex_iterator(); ++it ) {
-        std::string result = it->str();
-        
-        if (isdigit(result[0]) || (result.length() > 1 && result[0] == '-')) {
-            output.push_back(it->str());
-            continue;
-        }
-        
-        if (isOperator(result.c_str()[0])) {
-            while (!operators.empty() && precedence(operators.top()) >= precedence(result.c_str()[0])) {
-                output.push_back(std::string(1, operators.top()));
-                operators.pop();
-            }
-            operators.push(result.c_str()[0]);
-            continue;
-        }
-        
-        if (result.c_str()[0] == '(') {
-            operators.push('(');
-            continue;
-        }
-        
-        if (result.c_str()[0] == ')') {
-            while (!operators.empty() && operators.top() != '(') {
-                output.push_back(std::string(1, operators.top()));
-                operators.pop();
-            }
-            if (operators.empty()) {
-                std::cout << MessageType::Error << "#[]: missing '(' in expression '" << expression << "'\n";
-                continue;
-            }
-            
-            operators.pop();  // Remove the '(' from stack
-            continue;
+    skipSpaces(parser);
+    if (parser.pos == parser.str.length()) return -1;
+    
+    if (isdigit((unsigned char)parser.str[parser.pos])) {
+        while (parser.pos < parser.str.length() && isdigit((unsigned char)parser.str[parser.pos])) {
+            int digit = parser.str[parser.pos++] - '0';
+            if (__builtin_mul_overflow(value.i, 10, &value.i) || __builtin_add_overflow(value.i, digit, &value.i)) return -1;
         }
-        
-        std::cout << MessageType::Error << "#[]: uknown '" << result << "' in expression '" << expression << "'\n";
+        if (parser.pos < parser.str.length() && isalpha((unsigned char)parser.str[parser.pos])) return -1;
+        return addValue(parser, value);
     }
     
-    while (!operators.empty()) {
-        output.push_back(std::string(1, operators.top()));
-        operators.pop();
+    if (parser.str[parser.pos] == '#') {
+        size_t length = Calc::convertPPLIntegerNumberToBase10(std::string_view(parser.str).substr(parser.pos), value);
+        if (!length) return -1;
+        parser.pos += length;
+        return addValue(parser, value);
     }
     
-    if (_verbose) {
-        std::cout << MessageType::Verbose << "calc: RPN: ";
-        for (auto it = output.begin(); it != output.end(); ) {
-            std::cout << *it;
-            if (++it != output.end()) {
-                std::cout << ",";
-            }
-        }
-        std::cout << "\n";
+    if (accept(parser, "(")) {
+        int node = parseExpression(parser);
+        return accept(parser, ")") ? node : -1;
+    }
+    
+    value.integer = false;
+    if (accept(parser, "e")) {
+        value.d = M_E;
+        return addValue(parser, value);
+    }
+    if (accept(parser, "pi") || accept(parser, "π")) {
+        value.d = M_PI;
+        return addValue(parser, value);
     }
     
-    return output;
+    return -1;
 }
 
-// Function to evaluate a postfix expression
-static double evaluatePostfix(const std::vector<std::string>& postfix) {
-    std::stack<double> values;
-    
-    for (const std::string& token : postfix) {
-        if (isdigit(token[0]) || (token.length() > 1 && token[0] == '-')) {
-            values.push(std::stod(token));
-            continue;
-        }
-        if (isOperator(token[0])) {
-            double b = values.top(); values.pop();
-            double a = values.top(); values.pop();
-            values.push(applyOperator(a, b, token[0]));
-        }
+static int parseUnary(TParser& parser) {
+    if (accept(parser, "-")) {
+        TNode node;
+        node.op = 'n';
+        node.lhs = parseUnary(parser);
+        if (node.lhs < 0) return -1;
+        parser.nodes.push_back(node);
+        return (int)parser.nodes.size() - 1;
+    }
+    return parsePrimary(parser);
+}
+
+static int parseProduct(TParser& parser) {
+    int node = parseUnary(parser);
+    
+    while (node >= 0) {
+        if (accept(parser, "*")) node = addNode(parser, '*', node, parseUnary(parser));
+        else if (accept(parser, "/")) node = addNode(parser, '/', node, parseUnary(parser));
+        else if (accept(parser, "%") || accept(parser, "MOD")) node = addNode(parser, '%', node, parseUnary(parser));
+        else break;
     }
+    return node;
+}
+
+static int parseSum(TParser& parser) {
+    int node = parseProduct(parser);
     
-    return values.top();
+    while (node >= 0) {
+        if (accept(parser, "+")) node = addNode(parser, '+', node, parseProduct(parser));
+        else if (accept(parser, "-")) node = addNode(parser, '-', node, parseProduct(parser));
+        else break;
+    }
+    return node;
 }
 
-// Function to evaluate an infix expression
-static double evaluateExpression(const std::string& expression) {
-    std::vector<std::string> postfix = infixToPostfix(expression);
-    return evaluatePostfix(postfix);
+static int parseAnd(TParser& parser) {
+    int node = parseSum(parser);
+    while (node >= 0 && accept(parser, "&")) node = addNode(parser, '&', node, parseSum(parser));
+    return node;
 }
 
+static int parseExpression(TParser& parser) {
+    int node = parseAnd(parser);
+    while (node >= 0 && accept(parser, "|")) node = addNode(parser, '|', node, parseAnd(parser));
+    return node;
+}
 
-// MARK: -
-// MARK: PPL Integer Number Handerling
+// MARK: - Folding
 
-// Function to convert a 64-bit number to a specified bit width
-static uint64_t convertToBitWidth(uint64_t num, int bitWidth) {
-    if (bitWidth <= 0) {
-        // If bit width is 0 or negative, return 0 (no bits to retain)
-        return 0;
+// An integer taking part in double arithmetic must convert exactly.
+static bool real(const TValue& value, double& d) {
+    if (!value.integer) {
+        d = value.d;
+        return true;
     }
-    
-    if (bitWidth >= 64) {
-        // If bit width is 64 or more, return the number as-is
-        return num;
+    if (value.i >= _exactLimit || value.i <= -_exactLimit) return false;
+    d = (double)value.i;
+    return true;
+}
+
+static bool foldIntegers(char op, int64_t a, int64_t b, TValue& result) {
+    switch (op) {
+        case '+': return !__builtin_add_overflow(a, b, &result.i);
+        case '-': return !__builtin_sub_overflow(a, b, &result.i);
+        case '*': return !__builtin_mul_overflow(a, b, &result.i);
+        case '&': result.i = a & b; return true;
+        case '|': result.i = a | b; return true;
+            
+        case '/':
+            if (b == -1) return !__builtin_sub_overflow(0, a, &result.i);
+            if (a % b == 0) {
+                result.i = a / b;
+                return true;
+            }
+            // Leaves a remainder, so the quotient is real.
+            result.integer = false;
+            if (a >= _exactLimit || a <= -_exactLimit || b >= _exactLimit || b <= -_exactLimit) return false;
+            result.d = (double)a / (double)b;
+            return true;
+            
+        case '%':
+            result.i = b == -1 ? 0 : a % b;
+            if (result.i < 0) result.i += b;
+            return true;
+            
+        default:
+            return false;
     }
-    
-    // Create a mask with the desired number of bits
-    uint64_t mask = (1ULL << bitWidth) - 1;
-    
-    // Apply the mask to the number and return the result
-    return num & mask;
 }
 
-// Function to perform two's complement on a number with a given bit width
-static int64_t twosComplement(int64_t num, int bitWidth) {
-    if (bitWidth <= 0 || bitWidth > 64) {
-        throw std::invalid_argument("Bit width must be between 1 and 64.");
+static bool foldReals(char op, double a, double b, TValue& result) {
+    result.integer = false;
+    
+    switch (op) {
+        case '+': result.d = a + b; return true;
+        case '-': result.d = a - b; return true;
+        case '*': result.d = a * b; return true;
+        case '/': result.d = a / b; return true;
+        case '%': result.d = fmod(a, b) < 0 ? b + fmod(a, b) : fmod(a, b); return true;
+            
+        default:
+            // & and | are only defined for integers.
+            return false;
     }
+}
+
+static bool fold(const std::vector<TNode>& nodes, int index, TValue& result) {
+    const TNode& node = nodes[index];
+    TValue a, b;
     
-    // Create a mask to fit within the specified bit width
-    int64_t mask = (1LL << bitWidth) - 1;
+    if (!node.op) {
+        result = node.value;
+        return true;
+    }
     
-    // Mask the number to limit it to the bit width
-    num &= mask;
+    if (!fold(nodes, node.lhs, a)) return false;
+    if (node.op != 'n' && !fold(nodes, node.rhs, b)) return false;
     
-    // Check if the number is negative in two's complement by checking the most significant bit
-    int64_t signBit = 1LL << (bitWidth - 1);
-    if (num & signBit) {
-        // The number is negative, so we apply two's complement
-        num = num - (1LL << bitWidth);  // Subtract 2^bitWidth to get the negative value
+    if ((node.op == '/' || node.op == '%') && (b.integer ? b.i == 0 : b.d == 0)) {
+        messages() << MessageType::Error << "#[]: division by zero\n";
+        return false;
     }
     
-    return num;
+    return Calc::evaluate(node.op, a, b, result);
 }
 
-static std::string decimalSignedNumber(int64_t num, int bitWidth) {
-    if (bitWidth < 1 || bitWidth > 64) bitWidth = 64;
+// MARK: -
+
+bool Calc::evaluate(char op, const TValue& a, const TValue& b, TValue& result)
+{
+    result = TValue();
     
-    num = convertToBitWidth(num, bitWidth);
-    num = twosComplement(num, bitWidth);
+    if (op == 'n') {
+        result = a;
+        if (a.integer) return !__builtin_sub_overflow(0, a.i, &result.i);
+        result.d = -a.d;
+        return true;
+    }
     
-    return std::to_string(num);
-}
-
-static std::string decimalUnsignedNumber(int64_t num, int bitWidth) {
-    if (bitWidth < 1 || bitWidth > 64) bitWidth = 64;
+    if ((op == '/' || op == '%') && (b.integer ? b.i == 0 : b.d == 0)) return false;
     
-    num = convertToBitWidth(num, bitWidth);
+    if (a.integer && b.integer) return foldIntegers(op, a.i, b.i, result);
     
-    return std::to_string(num);
+    double x, y;
+    if (!real(a, x) || !real(b, y)) return false;
+    return foldReals(op, x, y, result);
 }
 
-// Function to convert a string with PPL-style integer number to return a base 10 number
-static std::string convertPPLIntegerNumberToBase10(const std::string& str) {
-    std::regex re;
-    std::smatch match;
-    
-    re = R"(#([\dA-F]+)(?::(-)?(6[0-4]|[1-5][0-9]|[1-9]))?([odh])?)";
-    if (!regex_search(str, match, re)) return str;
-    
-    /*
-     Group 1 The hex part of the string.
-     Group 2 The signed part if given!.
-     Group 3 The bit width of the integer number if also given!
-     Group 4 The base type, should always be `h` in this case.
-     */
+size_t Calc::convertPPLIntegerNumberToBase10(std::string_view str, TValue& value)
+{
+    // #digits, an optional :bits or :-bits for a signed integer, then the letter of the base.
+    size_t pos = 1;
+    if (str.empty() || str[0] != '#') return 0;
+    
+    size_t digits = pos;
+    while (pos < str.length() && (isdigit((unsigned char)str[pos]) || (str[pos] >= 'A' && str[pos] <= 'F'))) pos++;
+    size_t end = pos;
+    if (end == digits) return 0;
+    
+    int bits = 64;
+    bool sign = false;
+    if (pos < str.length() && str[pos] == ':') {
+        pos++;
+        if (pos < str.length() && str[pos] == '-') {
+            sign = true;
+            pos++;
+        }
+        if (pos == str.length() || !isdigit((unsigned char)str[pos])) return 0;
+        for (bits = 0; pos < str.length() && isdigit((unsigned char)str[pos]); pos++) {
+            bits = bits * 10 + str[pos] - '0';
+            if (bits > 64) return 0;
+        }
+        if (bits < 1) return 0;
+    }
     
-    int base = 10;
-    if (match.str(4) == "h") base = 16;
-    if (match.str(4) == "o") base = 8;
+    if (pos == str.length()) return 0;
+    int base = str[pos] == 'h' ? 16 : str[pos] == 'd' ? 10 : str[pos] == 'o' ? 8 : str[pos] == 'b' ? 2 : 0;
+    if (!base) return 0;
+    pos++;
+    if (pos < str.length() && (isalnum((unsigned char)str[pos]) || str[pos] == '_')) return 0;
     
-    int64_t num = std::stol(match.str(1), nullptr, base);
-    int bitWidth = match.str(3).empty() ? 64 : atoi(match.str(3).c_str());
+    uint64_t n = 0;
+    for (size_t i = digits; i < end; ++i) {
+        uint64_t digit = isdigit((unsigned char)str[i]) ? str[i] - '0' : str[i] - 'A' + 10;
+        if (digit >= (uint64_t)base || __builtin_mul_overflow(n, (uint64_t)base, &n) || __builtin_add_overflow(n, digit, &n)) return 0;
+    }
     
-    if (match.str(2).empty())
-        return decimalUnsignedNumber(num, bitWidth);
+    // The value is that of the integer within its word size, as the calculator holds it.
+    if (bits < 64) n &= (uint64_t(1) << bits) - 1;
+    if (sign && (n >> (bits - 1)) & 1) {
+        value = TValue();
+        value.i = bits < 64 ? (int64_t)n - (int64_t(1) << (bits - 1)) - (int64_t(1) << (bits - 1)) : (int64_t)n;
+        return pos;
+    }
+    if (n > (uint64_t)INT64_MAX) return 0;
     
-    return decimalSignedNumber(num, bitWidth);
+    value = TValue();
+    value.i = (int64_t)n;
+    return pos;
 }
 
-// Function to convert a string with PPL-style integer number to a plain base 10 number
-static void convertPPLStyleNumberToBase10(std::string& str) {
-    std::regex re;
-    std::smatch match;
-    std::string s;
-    
-    re = R"(#([\dA-F])+(?::-?\d+)?([odh])?)";
-    while (regex_search(str, match, re)) {
-        /*
-         Group 1 The number part of the string.
-         Group 2 The base type, should be `h`, `d` or `o` if given!.
-         */
-        
-        s = convertPPLIntegerNumberToBase10(match.str());
-        str = str.replace(match.position(), match.length(), s);
+bool Calc::format(const TValue& value, std::string& str)
+{
+    if (value.integer) {
+        str = std::to_string(value.i);
+        return true;
     }
+    
+    // A real is given to 10 decimal places, less any trailing zeros, and only while its integer part is exact.
+    if (!std::isfinite(value.d) || fabs(value.d) >= (double)_exactLimit) return false;
+    
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.10f", value.d);
+    str = buffer;
+    str.erase(str.find_last_not_of('0') + 1, std::string::npos);
+    if (str.back() == '.') str.pop_back();
+    
+    return true;
 }
 
-// MARK: -
-
 bool Calc::parse(std::string& str)
 {
-    std::regex re;
-    std::smatch match;
-    
-    if (!isExpresionValid(str)) return false;
-    
-    std::string expression = str;
-    convertPPLStyleNumberToBase10(expression);
-    
-    expression = regex_replace(expression, std::regex(R"(e)"), "2.71828182845904523536028747135266250");
-    expression = regex_replace(expression, std::regex(R"(π|pi)"), "3.14159265358979323846264338327950288");
+    TParser parser = {str};
+    TValue value;
     
-    strip(expression);
+    parser.nodes.reserve(16);
+    int root = parseExpression(parser);
+    skipSpaces(parser);
+    if (root < 0 || parser.pos != str.length()) return false;
     
-    expression = separateExpression(expression);
-    double result = evaluateExpression(expression);
+    // A PPL integer on its own is left as one, being no calculation.
+    if (!parser.nodes[root].op && str.find('#') != std::string::npos) return false;
     
-    std::stringstream ss;
-    ss << std::fixed << std::setprecision(10) << result;
-    expression = ss.str();
-    expression.erase ( expression.find_last_not_of('0') + 1, std::string::npos );
-    if (expression.at(expression.length() - 1) == '.') {
-        expression.resize(expression.length() - 1);
-    }
-    str = expression;
+    if (!fold(parser.nodes, root, value)) return false;
     
-    return true;
+    return format(value, str);
 }
-
-
-
-
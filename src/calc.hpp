@@ -29,6 +29,7 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <deque>
 #include <stdint.h>
@@ -36,7 +37,34 @@
 namespace pp {
     class Calc {
     public:
+        /*
+         A value is kept as an exact 64-bit integer for as long as every operand is an integer and
+         no operation overflows or leaves a remainder, otherwise it becomes a double.
+         */
+        typedef struct TValue {
+            bool integer = true;
+            int64_t i = 0;
+            double d = 0;
+        } TValue;
+        
         static bool parse(std::string& str);
+        
+        /*
+         Reads a PPL integer, eg. #FF:64h or #FFFF:-16h, at the start of the text as an exact
+         integer, given its word size and whether it is signed. Returns the number of characters
+         read, or 0 should the text not start with a PPL integer, or its value not be held by an
+         int64.
+         */
+        static size_t convertPPLIntegerNumberToBase10(std::string_view str, TValue& value);
+        
+        /*
+         Folds a single operation, one of + - * / % & | or 'n' for negation, which ignores `b`.
+         Returns false should the divisor be zero, or the result not be representable.
+         */
+        static bool evaluate(char op, const TValue& a, const TValue& b, TValue& result);
+        
+        // The text of a value, unless it is a real that can't be given exactly to 10 decimal places.
+        static bool format(const TValue& value, std::string& str);
     };
 }
 
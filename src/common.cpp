@@ -24,36 +24,33 @@
 
 
 #include "common.hpp"
-#include "singleton.hpp"
+#include "context.hpp"
 
 #include <sstream>
 #include <algorithm>
-#include <regex>
 
-static bool _failed = false;
-
-bool hasErrors(void) {
-    return _failed;
-}
+using namespace pp;
 
 std::ostream& operator<<(std::ostream& os, MessageType type) {
-    Singleton *singlenton = Singleton::shared();
+    Context *context = Context::current();
 
-    if (!singlenton->currentPathname().empty()) {
-        os << ANSI::Blue << basename(singlenton->currentPathname()) << ANSI::Default << " on line " << ANSI::Bold;
-        os << singlenton->currentLineNumber() << ANSI::Default << " ";
+    if (context) context->diagnosticCount++;
+    
+    if (context && !context->currentPathname().empty()) {
+        os << ANSI::Blue << basename(context->currentPathname()) << ANSI::Default << " on line " << ANSI::Bold;
+        os << context->currentLineNumber() << ANSI::Default << " ";
     }
 
 
     switch (type) {
         case MessageType::Error:
             os << ANSI::Red << "error" << ANSI::Default << ": ";
-            _failed = true;
+            if (context) context->failed = true;
             break;
             
         case MessageType::CriticalError:
             os << "🛑 ";
-            _failed = true;
+            if (context) context->failed = true;
             break;
 
         case MessageType::Warning:
@@ -34,8 +34,6 @@
 #include <ostream>
 #include <fstream>
 
-#include "singleton.hpp"
-
 #define INDENT_WIDTH 2
 
 #define basename(path)  path.substr(path.find_last_of("/") + 1)
@@ -73,7 +71,6 @@ namespace ANSI {
 };
 
 
-bool hasErrors(void);
 std::ostream& operator<<(std::ostream& os, MessageType type);
 
 std::string& ltrim(std::string& str);
@@ -0,0 +1,93 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#include "context.hpp"
+
+using namespace pp;
+
+// The context being compiled on each thread, used for the location given by diagnostics.
+static thread_local Context *_current = nullptr;
+static thread_local Context::TLine *_line = nullptr;
+
+Context::Context(std::ostream& log) : scope(_scope), nestingLevel(_nestingLevel), aliases(*this), switches(*this), preprocessor(*this), log(log) {
+}
+
+Context *Context::current(void) {
+    return _current;
+}
+
+void Context::setCurrent(Context *context) {
+    _current = context;
+}
+
+void Context::setCurrentLine(TLine *line) {
+    _line = line;
+}
+
+std::ostream& Context::diagnostics(void) {
+    if (!_line) return log;
+    if (!_line->messages) _line->messages = std::make_unique<std::ostringstream>();
+    return *_line->messages;
+}
+
+long Context::currentLineNumber(void) {
+    if (_line) return _line->lineNumber;
+    if (_sources.empty()) return 0;
+    return _sources.back()->lineNumber();
+}
+
+long Context::totalLineCount(void) {
+    return _totalLines;
+}
+
+std::string Context::currentPathname(void) {
+    if (_line) return dependencies[_line->file].pathname;
+    if (_sources.empty()) return "";
+    return _sources.back()->pathname;
+}
+
+std::string Context::getPath(void) {
+    std::string pathname = _sources.front()->pathname;
+    if (pathname.empty()) return "";
+    pathname.resize(pathname.rfind('/') + 1);
+    return pathname;
+}
+
+void Context::pushSource(const Source& source) {
+    _sources.push_back(&source);
+    _files.push_back(dependencies.size());
+    dependencies.push_back({source.pathname, Cache::hash(source.contents())});
+}
+
+void Context::popSource(void) {
+    _totalLines += _sources.back()->lineNumber();
+    _sources.pop_back();
+    _files.pop_back();
+}
+
+void Context::deferLine(std::string& text, size_t offset, Remainder remainder) {
+    lines.push_back({std::move(text), remainder, strings, _nestingLevel, _scope, offset, _files.back(), currentLineNumber()});
+    text.clear();
+}
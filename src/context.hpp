@@ -0,0 +1,181 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef CONTEXT_HPP
+#define CONTEXT_HPP
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include "aliases.hpp"
+#include "switch.hpp"
+#include "preprocessor.hpp"
+#include "strings.hpp"
+#include "source.hpp"
+#include "cache.hpp"
+#include "timer.hpp"
+
+namespace pp {
+    /*
+     Holds all the state of compiling one program, from its aliases and preprocessor to the
+     pathname and line currently being compiled. Every stage of the pipeline is handed the
+     context it works on, so any number of programs can be compiled at the same time, one
+     context each.
+     */
+    class Context {
+    public:
+        enum class Scope {
+            Global = 1,
+            Local  = 2
+        };
+        const Scope &scope;
+        const int &nestingLevel;
+        
+        // How much of the rewriting of a line is left for the second pass
+        enum class Remainder {
+            Line,           // all that follows the resolving of aliases
+            Calculations,   // from simplifying calculations on
+            Formatting
+        };
+        
+        /*
+         A line left by the first pass for the second to rewrite, along with all of the state of
+         the first pass it depends on, so lines can be rewritten in any order on any thread.
+         */
+        typedef struct TLine {
+            std::string text;
+            Remainder remainder;
+            Strings strings;
+            int nestingLevel;
+            Scope scope;
+            size_t offset;          // where in the output the rewritten line belongs
+            size_t file;            // the index of the file the line came from in the dependencies
+            long lineNumber;
+            
+            // Diagnostics raised while rewriting, only created should there be any
+            std::unique_ptr<std::ostringstream> messages;
+        } TLine;
+        
+        
+        Aliases aliases;
+        Switch switches;
+        Preprocessor preprocessor;
+        Strings strings;
+        
+        // Code to be inserted before the `END;` of each scope that is still open
+        std::vector<std::string> closingScope;
+        
+        // Where all diagnostics for this program are written
+        std::ostream& log;
+        
+        // Every file the program was built from, the program itself first
+        std::vector<Cache::TDependency> dependencies;
+        
+        Profiler profiler;
+        
+        // Lines deferred to the second pass, in the order they appear in the output
+        std::vector<TLine> lines;
+        
+        /*
+         Lines resolved by the first pass, up to and including their aliases, by the text of the
+         line as it was read, for as long as the aliases they were resolved with are unchanged.
+         */
+        typedef struct TResolvedLine {
+            std::string text;
+            Strings strings;
+            uint64_t generation;
+        } TResolvedLine;
+        std::unordered_map<std::string, TResolvedLine> resolvedLines;
+        
+        // How many lines each pass looked for among the lines it had already translated, and found
+        typedef struct TMemoStatistics {
+            long lookups = 0;
+            long hits = 0;
+        } TMemoStatistics;
+        TMemoStatistics resolveMemo;
+        TMemoStatistics rewriteMemo;
+        
+        // Set by any error or critical error reported while this program was being compiled
+        std::atomic<bool> failed = false;
+        
+        // The number of diagnostics of any kind reported so far
+        std::atomic<long> diagnosticCount = 0;
+        
+        
+        Context(std::ostream& log = std::cout);
+        
+        // returns the context being compiled on the calling thread, if any
+        static Context *current(void);
+        static void setCurrent(Context *context);
+        
+        // The line being rewritten by the second pass on the calling thread, if any
+        static void setCurrentLine(TLine *line);
+        
+        // returns where diagnostics go, the line being rewritten on the calling thread has its own
+        std::ostream& diagnostics(void);
+        
+        // returns the number of the line being compiled, as given by the line index of its source
+        long currentLineNumber(void);
+        
+        // returns the number of lines processed across all files
+        long totalLineCount(void);
+        
+        
+        std::string currentPathname(void);
+        
+        // returns the pathname of
+        std::string getPath(void);
+        
+        // The source being compiled, an included file being pushed on top of the source that includes it.
+        void pushSource(const Source& source);
+        void popSource(void);
+        
+        // Defers the rest of the line being compiled to the second pass, to be put at `offset` in the output.
+        void deferLine(std::string& text, size_t offset, Remainder remainder);
+        
+        
+        void setNestingLevel(int new_value) {
+            _nestingLevel = new_value;
+            _scope = (_nestingLevel == 0) ? Scope::Global : Scope::Local;
+        }
+        
+    private:
+        std::vector<const Source *> _sources;
+        std::vector<size_t> _files;
+        
+        int _nestingLevel = 0;
+        Scope _scope = Scope::Global;
+        
+        long _totalLines = 0;
+        
+        Context(const Context &);
+        Context& operator=(const Context &);
+    };
+}
+
+#endif /* CONTEXT_HPP */
@@ -0,0 +1,146 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#include "lexer.hpp"
+
+#include <cstring>
+
+using namespace pp;
+
+static bool isWordStart(const char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+}
+
+static bool isWordCharacter(const char c) {
+    return isWordStart(c) || (c >= '0' && c <= '9');
+}
+
+static bool isWhitespace(const char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+/*
+ Multi-character operators, longest first so that the first match found is
+ always the longest possible one (maximal munch).
+ */
+static const char *_operators[] = {
+    "<<=", ">>=",
+    ">=", "<=", "!=", "<>", "=>", "==", ":=", "::",
+    "&&", "||", "^^", "<<", ">>",
+    "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=",
+    nullptr
+};
+
+static size_t operatorLength(const std::string& str, size_t pos) {
+    for (const char **op = _operators; *op; ++op) {
+        if (str.compare(pos, strlen(*op), *op) == 0) return strlen(*op);
+    }
+    return 1;
+}
+
+static size_t utf8SequenceLength(const unsigned char c) {
+    if ((c & 0b11100000) == 0b11000000) return 2;
+    if ((c & 0b11110000) == 0b11100000) return 3;
+    if ((c & 0b11111000) == 0b11110000) return 4;
+    return 1;
+}
+
+std::vector<Lexer::TToken> Lexer::tokenize(const std::string& str) {
+    std::vector<TToken> tokens;
+    size_t i = 0, n = str.length();
+    bool leading = true;
+    
+    tokens.reserve(n / 2 + 1);
+    
+    while (i < n) {
+        size_t start = i;
+        char c = str[i];
+        Type type;
+        
+        if (isWhitespace(c)) {
+            while (i < n && isWhitespace(str[i])) i++;
+            tokens.push_back({Type::Whitespace, str.substr(start, i - start)});
+            continue;
+        }
+        
+        if (isWordStart(c)) {
+            while (i < n && isWordCharacter(str[i])) i++;
+            type = Type::Identifier;
+        }
+        else if (c >= '0' && c <= '9') {
+            // A number runs on through any letters, digits or decimal points, eg. 0xFF, 3.14 or 1e5
+            while (i < n && (isWordCharacter(str[i]) || str[i] == '.')) i++;
+            type = Type::Number;
+        }
+        else if (c == '"') {
+            i = str.find('"', i + 1);
+            i = i == std::string::npos ? n : i + 1;
+            type = Type::String;
+        }
+        else if (c == '#' && leading && i + 1 < n && isWordStart(str[i + 1])) {
+            i++;
+            while (i < n && isWordCharacter(str[i])) i++;
+            type = Type::Directive;
+        }
+        else if ((unsigned char)c >= 0x80) {
+            i += utf8SequenceLength(c);
+            if (i > n) i = n;
+            type = Type::Symbol;
+        }
+        else {
+            i += operatorLength(str, i);
+            type = Type::Operator;
+        }
+        
+        tokens.push_back({type, str.substr(start, i - start)});
+        leading = false;
+    }
+    
+    return tokens;
+}
+
+const char *const *Lexer::operators(void) {
+    return _operators;
+}
+
+std::string Lexer::join(const std::vector<TToken>& tokens) {
+    std::string str;
+    size_t length = 0;
+    
+    for (const auto& token : tokens) length += token.text.length();
+    str.reserve(length);
+    for (const auto& token : tokens) str.append(token.text);
+    
+    return str;
+}
+
+void Lexer::collapseWhitespace(std::vector<TToken>& tokens) {
+    while (!tokens.empty() && Type::Whitespace == tokens.back().type) tokens.pop_back();
+    if (!tokens.empty() && Type::Whitespace == tokens.front().type) tokens.erase(tokens.begin());
+    
+    for (auto& token : tokens) {
+        if (Type::Whitespace == token.type) token.text = " ";
+    }
+}
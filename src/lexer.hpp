@@ -0,0 +1,66 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef LEXER_HPP
+#define LEXER_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+namespace pp {
+    class Lexer {
+    public:
+        enum class Type {
+            Whitespace,
+            Identifier,
+            Number,
+            String,
+            Operator,
+            Directive,
+            Symbol
+        };
+        
+        typedef struct TToken {
+            Type type;
+            std::string text;
+        } TToken;
+        
+        /*
+         Splits a single line into a stream of tokens in one left-to-right pass.
+         Joining the tokens back together always reproduces the original line.
+         */
+        static std::vector<TToken> tokenize(const std::string& str);
+        static std::string join(const std::vector<TToken>& tokens);
+        
+        // The multi-character operators, each of which is a single token, as a null terminated list.
+        static const char *const *operators(void);
+        
+        // Replaces every run of whitespace with a single space and drops any leading or trailing whitespace.
+        static void collapseWhitespace(std::vector<TToken>& tokens);
+    };
+}
+
+#endif /* LEXER_HPP */
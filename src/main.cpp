@@ -25,21 +25,32 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <regex>
+#include <algorithm>
 #include <cstring>
 #include <iomanip>
 #include <cmath>
 #include <sys/time.h>
 #include <ctime>
 #include <vector>
+#include <unordered_set>
+#include <thread>
+#include <atomic>
+#include <mutex>
 
 #include "timer.hpp"
-#include "singleton.hpp"
+#include "context.hpp"
 #include "common.hpp"
 
 #include "preprocessor.hpp"
+#include "lexer.hpp"
+#include "rewriter.hpp"
+#include "patterns.hpp"
 #include "strings.hpp"
 #include "calc.hpp"
+#include "optimizer.hpp"
+#include "utf16.hpp"
+#include "source.hpp"
+#include "cache.hpp"
 
 #include "version_code.h"
 
@@ -47,10 +58,29 @@
 
 using namespace pp;
 
-static Preprocessor preprocessor = Preprocessor();
-static Strings strings = Strings();
-
 static std::string _basename;
+static std::string _path;
+static bool _verboseAliases = false;
+static bool _verbosePreprocessor = false;
+static bool _verbosePatterns = false;
+static bool _verboseTimings = false;
+static bool _verboseOptimizer = false;
+static bool _optimize = true;
+static std::string _traceFilename;
+static Cache *_cache = nullptr;
+static int _rewriteJobs = 1;
+
+// Macros defined for every program before it is compiled.
+static const char *_predefined[] = {
+    "#define __primec",
+    "#define __SCREEN G0",
+    "#define __SCREEN_WIDTH 320",
+    "#define __SCREEN_HEIGHT 240",
+    "#define __LIST_LIMIT 10000",
+    "#define true 1",
+    "#define false 0",
+    nullptr
+};
 
 
 void terminator() {
@@ -61,7 +91,7 @@ void terminator() {
 void (*old_terminate)() = std::set_terminate(terminator);
 
 
-void translatePrimeCToPPL(const std::string& pathname, std::ofstream &outfile);
+void translatePrimeCToPPL(const std::string& pathname, UTF16Writer& output, Context& context);
 
 // MARK: - Utills
 
@@ -102,38 +132,10 @@ static std::string decimalToBase24(long num) {
 }
 
 
-uint32_t utf8_to_utf16(const char *str) {
-    uint8_t *utf8 = (uint8_t *)str;
-    uint16_t utf16 = *utf8;
-    
-    if ((utf8[0] & 0b11110000) == 0b11100000) {
-        utf16 = utf8[0] & 0b11111;
-        utf16 <<= 6;
-        utf16 |= utf8[1] & 0b111111;
-        utf16 <<= 6;
-        utf16 |= utf8[2] & 0b111111;
-        return utf16;
-    }
-    
-    // 110xxxxx 10xxxxxx
-    if ((utf8[0] & 0b11100000) == 0b11000000) {
-        utf16 = utf8[0] & 0b11111;
-        utf16 <<= 6;
-        utf16 |= utf8[1] & 0b111111;
-        return utf16;
-    }
-    
-    return utf16;
-}
-
 // Function to remove whitespaces around specific operators using regular expressions
 std::string removeWhitespaceAroundOperators(const std::string& str) {
-    // Regular expression pattern to match spaces around the specified operators
-    // Operators: {}[]()≤≥≠<>=*/+-▶.,;:!^
-    std::regex re(R"(\s*([{}[\]()≤≥≠<>=*\/+\-▶.,;:!^&|%])\s*)");
-
     // Replace matches with the operator and no surrounding spaces
-    std::string result = std::regex_replace(str, re, "$1");
+    std::string result = Patterns::WhitespaceAroundOperators.replace(str, "$1");
     
     return result;
 }
@@ -145,63 +147,61 @@ std::string removeWhitespaceAroundOperators(const std::string& str) {
  */
 std::string expandAssignment(const std::string& expression) {
     std::string str = expression;
-    std::regex re;
-    
-    re = R"(([A-Za-z]\w* *(?:\[.*\])*)([*\/+\-&|^%]|(?:>>|<<))=)";
-    str = regex_replace(str, re, "$1:=$1$2");
     
-    
-    re = R"(%)";
-    str = regex_replace(str, re, " MOD ");
+    str = Patterns::CompoundAssignment.replace(str, "$1:=$1$2");
+    str = Patterns::Modulo.replace(str, " MOD ");
     
     return str;
 }
 
 void translateCLogicalOperatorsToPPL(std::string& str) {
-    str = regex_replace(str, std::regex(R"(&&)"), " AND ");
-    str = regex_replace(str, std::regex(R"(\|\|)"), " OR ");
-    str = regex_replace(str, std::regex(R"(!)"), " NOT ");
-    str = regex_replace(str, std::regex(R"(\^\^)"), " XOR ");
+    static const Rewriter rewriter({
+        {"&&", " AND ", Rewriter::Kind::Anywhere},
+        {"||", " OR ", Rewriter::Kind::Anywhere},
+        {"!", " NOT ", Rewriter::Kind::Anywhere},
+        {"^^", " XOR ", Rewriter::Kind::Anywhere}
+    }, false);
+    
+    rewriter.rewrite(str);
 }
 
 void removeTemplateSyntax(std::string& str) {
-    str = regex_replace(str, std::regex(R"(< *LOCAL *>)"), "");
+    str = Patterns::TemplateSyntax.replace(str, "");
 }
 
 void removeTypeCastingSyntax(std::string& str) {
-    str = regex_replace(str, std::regex(R"(\( *LOCAL *\))"), "");
+    str = Patterns::TypeCastingSyntax.replace(str, "");
 }
 
 void simplifyCalculations(std::string& str) {
-    std::regex re;
-    std::smatch match;
+    Match match;
     
-    re = R"(\b(?:(?:LOCAL|CONST) +)?[A-Za-z]\w* *:= *(.+);)";
-    if (std::regex_search(str, match, re)) {
+    if (Patterns::AssignedExpression.search(str, match)) {
         std::string ppl = match[1].str();//"[" + match[1].str() + "]";
         if (Calc::parse(ppl)) {
             str = str.replace(match.position(1), match.length(1), ppl);
         }
     }
     
-    re = R"(\b[A-Za-z]\w* *:= *[A-Za-z]\w* *[\-\+\*\/] *([\d \+\-\*\/\(\)]*);)";
-    if (std::regex_search(str, match, re)) {
+    if (Patterns::AssignedArithmetic.search(str, match)) {
         std::string ppl = "[" + match[1].str() + "]";
         if (Calc::parse(ppl)) {
             str = str.replace(match.position(1), match.length(1), ppl);
         }
     }
     
-    re = R"(\b[A-Za-z]\w* *\((.+)\))";
-    if (std::regex_search(str, match, re)) {
-        re = R"([^,]+(?=[^,]*))";
-        std::smatch matches;
+    if (Patterns::FunctionArguments.search(str, match)) {
         std::string s = match[1].str();
+        std::vector<std::pair<size_t, size_t>> arguments;
         
-        for(std::sregex_iterator it = std::sregex_iterator(s.begin(), s.end(), re); it != std::sregex_iterator(); ++it) {
-            std::string expression = it->str();
+        // The arguments are folded last to first, so that folding one leaves the positions of those before it intact.
+        for(MatchIterator it = Patterns::CommaSeparated.iterator(s); it != MatchIterator(); ++it) {
+            arguments.push_back({it->position(), it->length()});
+        }
+        for (auto it = arguments.rbegin(); it != arguments.rend(); ++it) {
+            std::string expression = s.substr(it->first, it->second);
             if (Calc::parse(expression)) {
-                s = s.replace(it->position(), it->length(), expression);
+                s = s.replace(it->first, it->second, expression);
             }
         }
         str = str.replace(match.position(1), match.length(1), s);
@@ -209,10 +209,7 @@ void simplifyCalculations(std::string& str) {
 }
 
 // MARK: - Prime-C To PPL Translater...
-void reformatPPLLine(std::string& str) {
-    std::regex re;
-    std::smatch match;
-    
+void reformatPPLLine(std::string& str, int nestingLevel, Context::Scope scope) {
     Strings strings = Strings();
     
     /*
@@ -231,11 +228,11 @@ void reformatPPLLine(std::string& str) {
     
     str = removeWhitespaceAroundOperators(str);
     
-    str = regex_replace(str, std::regex(R"(,)"), ", ");
-    str = regex_replace(str, std::regex(R"(\{)"), "{ ");
-    str = regex_replace(str, std::regex(R"(\})"), " }");
-    str = regex_replace(str, std::regex(R"(^ +(\} *;))"), "$1\n");
-    str = regex_replace(str, std::regex(R"(\{ +\})"), "{}");
+    str = Patterns::Comma.replace(str, ", ");
+    str = Patterns::OpeningBrace.replace(str, "{ ");
+    str = Patterns::ClosingBrace.replace(str, " }");
+    str = Patterns::ClosingBraceStatement.replace(str, "$1\n");
+    str = Patterns::EmptyBraces.replace(str, "{}");
     
     /*
      To prevent correcting over-modifications, first replace all double `==` with a single `=`.
@@ -247,224 +244,367 @@ void reformatPPLLine(std::string& str) {
      `=` or `:=` with surrounding whitespace are targeted, we can then safely convert `=` to `==`
      without affecting other operators.
      */
-    str = regex_replace(str, std::regex(R"(==)"), "=");
+    str = Patterns::DoubleEquals.replace(str, "=");
 
     // Ensuring that standalone `≥`, `≤`, `≠`, `=`, `:=`, `+`, `-`, `*` and `/` have surrounding whitespace.
-    re = R"(≥|≤|≠|=|:=|\+|-|\*|\/|▶)";
-    str = regex_replace(str, re, " $0 ");
+    str = Patterns::SpacedOperators.replace(str, " $0 ");
     
     // We now hand the issue of Unary Minus/Operator
     
     // Ensuring that `≥`, `≤`, `≠`, `=`, `+`, `-`, `*` and `/` have a whitespace befor `-`.
-    re = R"(([≥≤≠=\+|\-|\*|\/]) +- +)";
-    str = regex_replace(str, re, "$1 -");
+    str = Patterns::UnaryMinusAfterOperator.replace(str, "$1 -");
     
     // Ensuring that `-` in  `{ - `, `( - ` and `[ - ` situations have no surrounding whitespace.
-    re = R"(([({[]) +- +)";
-    str = regex_replace(str, re, "$1-");
+    str = Patterns::UnaryMinusAfterBracket.replace(str, "$1-");
     
-    if (!regex_search(str, std::regex(R"(LOCAL [A-Za-z]\w* = )"))) {
+    if (!Patterns::LocalInitialisation.search(str)) {
         // We can now safely convert `=` to `==` without affecting other operators.
-        str = regex_replace(str, std::regex(R"( = )"), " == ");
+        str = Patterns::SpacedEquals.replace(str, " == ");
     }
     
-    str = regex_replace(str, std::regex(R"(;(END|WHILE)\b)"), "; $1");
-    str = regex_replace(str, std::regex(R"(\b *(AND|OR|NOT) *\b)"), " $1 ");
+    str = Patterns::SemicolonKeyword.replace(str, "; $1");
+    str = Patterns::LogicalKeyword.replace(str, " $1 ");
     
-    if (Singleton::Scope::Global == Singleton::shared()->scope) {
-        str = regex_replace(str, std::regex(R"(^ *END;$)"), "$0\n");
-        str = regex_replace(str, std::regex(R"(^ *LOCAL +)"), "");
+    if (Context::Scope::Global == scope) {
+        str = Patterns::EndStatement.replace(str, "$0\n");
+        str = Patterns::LeadingLocal.replace(str, "");
     }
     
     
     
-    re = R"(\b(BEGIN|IF|WHILE|REPEAT|CASE|ELSE|DEFAULT)\b)";
-    if (regex_search(str, re)) {
-        str.insert(0, std::string((Singleton::shared()->nestingLevel - 1) * INDENT_WIDTH, ' '));
+    if (Patterns::BlockKeyword.search(str)) {
+        str.insert(0, std::string((nestingLevel - 1) * INDENT_WIDTH, ' '));
     }
     else {
-        str.insert(0, std::string(Singleton::shared()->nestingLevel * INDENT_WIDTH, ' '));
+        str.insert(0, std::string(nestingLevel * INDENT_WIDTH, ' '));
     }
     
     strings.restoreStrings(str);
 }
 
-void capitalizePPLKeywords(std::string& str) {
-    std::string result = str;
-    std::regex re(R"(\b(begin|end|return|kill|if|then|else|xor|or|and|not|case|default|iferr|ifte|for|from|step|downto|to|do|while|repeat|until|break|continue|export|const|local|key)\b)", std::regex_constants::icase);
+/*
+ Converts any >= != <> <= or => to PPL's ≥ ≠ ≤ and ▶ and turns any keyword that is in lowercase
+ to uppercase, all in a single scan of the line.
+ */
+void translateCOperatorsAndKeywordsToPPL(std::string& str) {
+    static const Rewriter rewriter({
+        {">=", "≥", Rewriter::Kind::Anywhere},
+        {"!=", "≠", Rewriter::Kind::Anywhere},
+        {"<>", "≠", Rewriter::Kind::Anywhere},
+        {"<=", "≤", Rewriter::Kind::Anywhere},
+        {"=>", "▶", Rewriter::Kind::Anywhere},
+        
+        {"begin", "BEGIN", Rewriter::Kind::Word},
+        {"end", "END", Rewriter::Kind::Word},
+        {"return", "RETURN", Rewriter::Kind::Word},
+        {"kill", "KILL", Rewriter::Kind::Word},
+        {"if", "IF", Rewriter::Kind::Word},
+        {"then", "THEN", Rewriter::Kind::Word},
+        {"else", "ELSE", Rewriter::Kind::Word},
+        {"xor", "XOR", Rewriter::Kind::Word},
+        {"or", "OR", Rewriter::Kind::Word},
+        {"and", "AND", Rewriter::Kind::Word},
+        {"not", "NOT", Rewriter::Kind::Word},
+        {"case", "CASE", Rewriter::Kind::Word},
+        {"default", "DEFAULT", Rewriter::Kind::Word},
+        {"iferr", "IFERR", Rewriter::Kind::Word},
+        {"ifte", "IFTE", Rewriter::Kind::Word},
+        {"for", "FOR", Rewriter::Kind::Word},
+        {"from", "FROM", Rewriter::Kind::Word},
+        {"step", "STEP", Rewriter::Kind::Word},
+        {"downto", "DOWNTO", Rewriter::Kind::Word},
+        {"to", "TO", Rewriter::Kind::Word},
+        {"do", "DO", Rewriter::Kind::Word},
+        {"while", "WHILE", Rewriter::Kind::Word},
+        {"repeat", "REPEAT", Rewriter::Kind::Word},
+        {"until", "UNTIL", Rewriter::Kind::Word},
+        {"break", "BREAK", Rewriter::Kind::Word},
+        {"continue", "CONTINUE", Rewriter::Kind::Word},
+        {"export", "EXPORT", Rewriter::Kind::Word},
+        {"const", "CONST", Rewriter::Kind::Word},
+        {"local", "LOCAL", Rewriter::Kind::Word},
+        {"key", "KEY", Rewriter::Kind::Word}
+    }, true);
+    
+    rewriter.rewrite(str);
+}
+
+/*
+ Converts C-style hexadecimal and binary literals to PPL integers, removes the
+ `sub` and `function` keywords and turns any Prime-C type into LOCAL.
+ */
+void translatePrimeCTypesToPPL(std::vector<Lexer::TToken>& tokens) {
+    static const std::unordered_set<std::string> types = {
+        "List", "Float32", "Float64"
+    };
     
-    // We turn any keywords that are in lowercase to uppercase
-    for(std::sregex_iterator it = std::sregex_iterator(str.begin(), str.end(), re); it != std::sregex_iterator(); ++it) {
-        std::string result = it->str();
-        std::transform(result.begin(), result.end(), result.begin(), ::toupper);
-        str = str.replace(it->position(), it->length(), result);
+    for (auto it = tokens.begin(); it != tokens.end(); ++it) {
+        std::string& text = it->text;
+        
+        if (Lexer::Type::Number == it->type && text.length() > 2 && text[0] == '0') {
+            size_t length;
+            if (text[1] == 'x') {
+                length = text.find_first_not_of("0123456789ABCDEF", 2);
+                if (length == std::string::npos) length = text.length();
+                if (length > 2) text = "#" + text.substr(2, length - 2) + ":64h" + text.substr(length);
+                continue;
+            }
+            if (text[1] == 'b') {
+                length = text.find_first_not_of("01", 2);
+                if (length == std::string::npos) length = text.length();
+                if (length > 2) text = "#" + text.substr(2, length - 2) + ":64b" + text.substr(length);
+                continue;
+            }
+        }
+        
+        if (Lexer::Type::Identifier != it->type) continue;
+        
+        if ((text == "sub" || text == "function") && it + 1 != tokens.end() && Lexer::Type::Whitespace == (it + 1)->type) {
+            text.clear();
+            (it + 1)->text.clear();
+            continue;
+        }
+        
+        // U?Int\d{0,2}
+        size_t offset = text.starts_with("UInt") ? 4 : text.starts_with("Int") ? 3 : 0;
+        if (offset && text.length() - offset <= 2 && text.find_first_not_of("0123456789", offset) == std::string::npos) {
+            text = "LOCAL";
+            continue;
+        }
+        
+        if (types.contains(text)) text = "LOCAL";
     }
 }
 
-void translatePrimeCLine(std::string& ln, std::ofstream& outfile) {
-    std::regex re;
-    std::smatch match;
-    std::ifstream infile;
+// MARK: - Rewriting
+
+/*
+ The rewriting that depends on nothing more than the line itself, along with its nesting level
+ and scope, shared by both the first pass and lines deferred to the second.
+ */
+void translatePrimeCTypes(std::string& ln) {
+    std::vector<Lexer::TToken> tokens = Lexer::tokenize(ln);
+    translatePrimeCTypesToPPL(tokens);
+    ln = Lexer::join(tokens);
     
-    static std::vector<std::string> closingScope;
+    ln = Patterns::ListDeclaration.replace(ln, "LOCAL $1:=MAKELIST(0,1,$2)");
     
-    Singleton *singleton = Singleton::shared();
     
+    removeTemplateSyntax(ln);
+    removeTypeCastingSyntax(ln);
+}
+
+void translatePrimeCSubscripts(std::string& ln) {
+    Match match;
     
-    /*
-     While parsing the contents, strings may inadvertently undergo parsing, leading
-     to potential disruptions in the string's content.
-     
-     To address this issue, we prioritize the preservation of any existing strings.
-     After we prioritize the preservation of any existing strings, we blank out the
-     string/s.
-     
-     Subsequently, after parsing, any strings that have been blanked out can be
-     restored to their original state.
-     */
-    strings.preserveStrings(ln);
-    strings.blankOutStrings(ln);
+    ln = Patterns::ConstLocal.replace(ln, "CONST");
     
-    ln = regex_replace(ln, std::regex(R"(\s+)"), " "); // All multiple whitespaces in succesion to a single space, future reg-ex will not require to deal with '\t', only spaces.
     
+    ln = Patterns::Sleep.replace(ln, "");
     
-    // Remove any leading white spaces before or after.
-    trim(ln);
-    removeWhitespaceAroundOperators(ln);
     
-    re = R"(\#pragma mode *\(.*\)$)";
-    if (std::regex_match(ln, re)) {
-        ln += '\n';
-        return;
+    ln = Patterns::Subscript.replace(ln, "[($1)+1]");
+    
+    while (Patterns::LiteralSubscript.search(ln, match)) {
+        int digit = atoi(match[2].str().c_str());
+        ln = ln.replace(match.position(), match.length(), "[" + std::to_string(++digit) + "]");
     }
     
-    if (preprocessor.parse(ln)) {
-        if (!preprocessor.pathname.empty()) {
-            // Flagged with #include preprocessor for file inclusion, we process it before continuing.
-            translatePrimeCToPPL(preprocessor.pathname, outfile);
+    ln = Patterns::AdjacentSubscripts.replace(ln, ",");
+    
+    ln = Patterns::LocalArrayDeclaration.replace(ln, "$1$2");
+}
+
+void translatePrimeCScopedSyntax(std::string& ln, Context::Scope scope) {
+    if (scope == Context::Scope::Global) {
+        TokenIterator it = Patterns::KeyName.tokenIterator(ln, {1});
+        if (it != TokenIterator()) {
+            std::string s = *it;
+            ln = "KEY " + s + "()";
         }
         
-        ln = std::string("");
-        return;
+        ln = Patterns::ExportOrLocal.replace(ln, "");
+        
+        ln = Patterns::Main.replace(ln, "START");
     }
     
-   
-    
+    if (scope == Context::Scope::Local) {
+        translateCLogicalOperatorsToPPL(ln);
+    }
+}
+
+void translatePrimeCListMethods(std::string& ln) {
+    ln = Patterns::PushBack.replace(ln, "CONCAT($1,$2)▶$1");
+    ln = Patterns::Front.replace(ln, "$1(1)");
+    ln = Patterns::Back.replace(ln, "$1(length($1))");
+    ln = Patterns::Length.replace(ln, "length($1)");
+    ln = Patterns::At.replace(ln, "$1($2)");
+}
+
+/*
+ A line that can neither change nor depend upon the state of the first pass, other than its
+ nesting level and scope, has the rest of its rewriting deferred to the second pass. Any line
+ within a switch, or that may open or close a scope, must be rewritten by the first pass.
+ */
+static bool isDeferrable(const std::string& ln, Context& context) {
+    if (context.switches.active()) return false;
+    if (ln.find_first_of("{}") != std::string::npos) return false;
+    return ln.find("BEGIN") == std::string::npos && ln.find("END") == std::string::npos;
+}
+
+// MARK: - First Pass
+
+/*
+ The first pass up to and including the resolving of aliases, returning false should the line
+ have been consumed by the preprocessor, or dropped for being within a region excluded by a
+ conditional directive.
+ */
+static bool resolvePrimeCLine(std::string& ln, UTF16Writer& output, Context& context, Profiler::Section& section) {
+    std::vector<Lexer::TToken> tokens;
     
     /*
-     In C++, the standard library provides support for regular expressions
-     through the <regex> library, but it does not support lookbehind
-     assertions (such as (?<!...)) directly, as they are not part of the
-     regular expressions supported by the C++ Standard Library.
+     While parsing the contents, strings may inadvertently undergo parsing, leading
+     to potential disruptions in the string's content.
      
-     However, we can work around this limitation by adjusting your regular
-     expression to achieve the same result using alternative techniques.
+     To address this issue, we prioritize the preservation of any existing strings.
+     After we prioritize the preservation of any existing strings, we blank out the
+     string/s.
      
-     This approach doesn’t fully replicate lookbehind functionality, but
-     it can be effective for simpler cases where a limited lookbehind is
-     required.
+     Subsequently, after parsing, any strings that have been blanked out can be
+     restored to their original state.
      */
-    std::string::const_iterator it(ln.cbegin());
-    re = R"((?:[^<>=]|^)(>=|!=|<>|<=|=>)(?!=[<>=]))";
+    context.strings.preserveStrings(ln);
+    context.strings.blankOutStrings(ln);
     
-    while (std::regex_search(it, ln.cend(), match, re)) {
-        // We will convert any >= != <= or => to PPLs ≥ ≠ ≤ and ▶
-        std::string s = match.str(1);
-        
-        // Replace the operator with the appropriate PPL symbol.
-        if (s == ">=") s = "≥";
-        if (s == "!=") s = "≠";
-        if (s == "<>") s = "≠";
-        if (s == "<=") s = "≤";
-        if (s == "=>") s = "▶";
+    /*
+     The line is split into tokens once, all multiple whitespaces in succesion become a single
+     space and any leading or trailing whitespace is dropped, future reg-ex will not require to
+     deal with '\t', only spaces.
+     */
+    tokens = Lexer::tokenize(ln);
+    Lexer::collapseWhitespace(tokens);
+    ln = Lexer::join(tokens);
+    
+    // Every preprocessor directive has a `#`, so any line without one can skip the preprocessor.
+    if (ln.find('#') != std::string::npos) {
+        section.next(Profiler::Stage::Preprocessor);
         
-        ln = ln.replace(match.position(1), match.length(1), s);
+        if (Lexer::Type::Directive == tokens.front().type && tokens.front().text == "#pragma") {
+            if (Patterns::PragmaMode.match(ln)) {
+                ln += '\n';
+                return false;
+            }
+        }
         
-        // Reset the iterator to the beginning
-        it = ln.cbegin();
+        // A directive sees its strings restored, so that a #define or #include gets the actual text.
+        std::string directive = ln;
+        context.strings.restoreStrings(directive);
         
+        if (context.preprocessor.parse(directive)) {
+            if (!context.preprocessor.pathname.empty()) {
+                // Flagged with #include preprocessor for file inclusion, we process it before continuing.
+                translatePrimeCToPPL(context.preprocessor.pathname, output, context);
+            }
+            
+            ln = std::string("");
+            return false;
+        }
     }
-
-    ln = expandAssignment(ln);
-    
-    capitalizePPLKeywords(ln);
-    
     
-    ln = singleton->aliases.resolveAllAliasesInText(ln);
+    // Lines within a region excluded by a conditional directive are dropped.
+    if (context.preprocessor.disregard) {
+        ln = std::string("");
+        return false;
+    }
     
-    re = R"(0x([\dA-F]+))";
-    ln = std::regex_replace(ln, re, "#$1:64h");
+    section.next(Profiler::Stage::Operators);
+    translateCOperatorsAndKeywordsToPPL(ln);
     
-    re = R"(0b([01]+))";
-    ln = std::regex_replace(ln, re, "#$1:64b");
+    ln = expandAssignment(ln);
     
-    re = R"(\b(sub|function) +)";
-    ln = std::regex_replace(ln, re, "");
+    section.next(Profiler::Stage::Aliases);
+    ln = context.aliases.resolveAllAliasesInText(ln);
     
-    re = R"(\b(List|U?Int\d{0,2}|Float(?:32|64))\b)";
-    ln = std::regex_replace(ln, re, "LOCAL");
+    return true;
+}
+
+void translatePrimeCLine(std::string& ln, UTF16Writer& output, Context& context) {
+    Match match;
     
-    re = R"(\bLOCAL<LOCAL> ([A-Za-z]\w*)\((\d+)\))";
-    ln = std::regex_replace(ln, re, "LOCAL $1:=MAKELIST(0,1,$2)");
+    std::vector<std::string>& closingScope = context.closingScope;
     
+    Profiler::Section section(context.profiler, Profiler::Stage::Lexer);
     
-    removeTemplateSyntax(ln);
-    removeTypeCastingSyntax(ln);
-    
-    if (singleton->switches.parse(ln)) {
-        goto exit;
+    /*
+     A line seen before resolves just as it did then, provided the aliases are unchanged since,
+     the line is no directive and resolving it reported nothing. Any line with a `#` is left to
+     the preprocessor.
+     */
+    if (ln.find('#') != std::string::npos) {
+        if (!resolvePrimeCLine(ln, output, context, section)) return;
+    } else {
+        context.resolveMemo.lookups++;
+        
+        auto it = context.resolvedLines.find(ln);
+        if (it != context.resolvedLines.end() && it->second.generation == context.aliases.generation()) {
+            context.resolveMemo.hits++;
+            
+            if (context.preprocessor.disregard) {
+                ln = std::string("");
+                return;
+            }
+            ln = it->second.text;
+            context.strings = it->second.strings;
+        } else {
+            std::string key = ln;
+            long diagnosticCount = context.diagnosticCount;
+            
+            if (!resolvePrimeCLine(ln, output, context, section)) return;
+            
+            if (diagnosticCount == context.diagnosticCount) {
+                context.resolvedLines[key] = {ln, context.strings, context.aliases.generation()};
+            }
+        }
     }
     
+    if (isDeferrable(ln, context)) {
+        context.deferLine(ln, output.size(), Context::Remainder::Line);
+        return;
+    }
     
+    section.next(Profiler::Stage::Types);
+    translatePrimeCTypes(ln);
     
-    re = R"(\bCONST +LOCAL\b)";
-    ln = std::regex_replace(ln, re, "CONST");
-    
-    
-    re = R"(\bSLEEP *;)";
-    ln = std::regex_replace(ln, re, "");
-    
-    
-    re = R"(\[([^\[\]]+)\])";
-    ln = regex_replace(ln, std::regex(R"(\[([^\[\]]+)\])"), "[($1)+1]");
-    
-    re = R"(\[(\((\d+)\) *\+ *1)\])";
-    while (std::regex_search(ln, match, re)) {
-        int digit = atoi(match[2].str().c_str());
-        ln = ln.replace(match.position(), match.length(), "[" + std::to_string(++digit) + "]");
+    section.next(Profiler::Stage::Switch);
+    if (context.switches.parse(ln)) {
+        context.deferLine(ln, output.size(), Context::Remainder::Formatting);
+        return;
     }
     
-    re = R"(\]\[)";
-    ln = std::regex_replace(ln, re, ",");
     
-    re = R"((LOCAL [A-Za-z]\w*)\[.*\]( *= *.*))";
-    ln = std::regex_replace(ln, re, "$1$2");
+    section.next(Profiler::Stage::Scope);
+    translatePrimeCSubscripts(ln);
     
-    re = R"(^ *\} *ELSE *\{ *$)";
-    ln = regex_replace(ln, re, "ELSE");
+    ln = Patterns::ElseLine.replace(ln, "ELSE");
     
     
     
     // Scope
     
-    if (singleton->nestingLevel == 0) {
-        re = R"(^\{ *$)";
-        ln = regex_replace(ln, re, "BEGIN");
+    if (context.nestingLevel == 0) {
+        ln = Patterns::OpeningBraceLine.replace(ln, "BEGIN");
     }
     
-    if (singleton->nestingLevel == 1) {
-        re = R"(^\} *$)";
-        ln = regex_replace(ln, re, "END");
+    if (context.nestingLevel == 1) {
+        ln = Patterns::ClosingBraceLine.replace(ln, "END");
     }
     
-    re = R"((?:(?:\)|REPEAT|CASE|DO) *\{|^ *BEGIN) *$)";
-    if (std::regex_search(ln, re)) {
-        singleton->setNestingLevel(singleton->nestingLevel + 1);
+    if (Patterns::ScopeOpening.search(ln)) {
+        context.setNestingLevel(context.nestingLevel + 1);
     }
     
-    re = R"(^ *(?:\}|END|\} *(?:UNTIL|WHILE) *\(.+\);) *$)";
-    if (std::regex_search(ln, re)) {
-        if (std::regex_search(ln, match, std::regex(R"(^ *\} *(UNTIL|WHILE) *\((.+)\); *$)"))) {
+    if (Patterns::ScopeClosing.search(ln)) {
+        if (Patterns::LoopCondition.search(ln, match)) {
             std::string statement;
             statement = trim_copy(match[2].str());
             if (match[1].str() == "WHILE") {
@@ -476,43 +616,27 @@ void translatePrimeCLine(std::string& ln, std::ofstream& outfile) {
         }
         
         if (closingScope.empty()) {
-            ln = std::regex_replace(ln, re, "END;");
+            ln = Patterns::ScopeClosing.replace(ln, "END;");
         } else {
-            ln = std::regex_replace(ln, re, closingScope.back() + "END;");
+            ln = Patterns::ScopeClosing.replace(ln, closingScope.back() + "END;");
             closingScope.pop_back();
         }
         
-        singleton->setNestingLevel(singleton->nestingLevel - 1);
+        context.setNestingLevel(context.nestingLevel - 1);
+        if (context.scope == Context::Scope::Global) {
+            context.aliases.removeAllLocalAliases();
+        }
     }
     
     
     // PPL uses := instead of C's = for assignment. Converting all = to PPL style :=
-    re = R"(([^:=]|^)(?:=)(?!=))";
-    ln = std::regex_replace(ln, re, "$1 := ");
+    ln = Patterns::Assignment.replace(ln, "$1 := ");
     
     
-    if (singleton->scope == Singleton::Scope::Global) {
-        re = R"(^ *(KS?A?_[A-Z\d][a-z]*) *$)";
-        std::sregex_token_iterator it = std::sregex_token_iterator {
-            ln.begin(), ln.end(), re, {1}
-        };
-        if (it != std::sregex_token_iterator()) {
-            std::string s = *it;
-            ln = "KEY " + s + "()";
-        }
-        
-        re = R"(\b(export|LOCAL)\b +)";
-        ln = std::regex_replace(ln, re, "");
-        
-        re = R"(^main\b)";
-        ln = std::regex_replace(ln, re, "START");
-    }
+    translatePrimeCScopedSyntax(ln, context.scope);
     
-    if (singleton->scope == Singleton::Scope::Local) {
-        translateCLogicalOperatorsToPPL(ln);
-        
-        re = R"(\bFOR\b *\((.*);(.*);(.*)\) *\{)";
-        if (std::regex_search(ln, match, re)) {
+    if (context.scope == Context::Scope::Local) {
+        if (Patterns::ForStatement.search(ln, match)) {
             std::string init, condition, increment, ppl;
             
             init = trim_copy(match[1].str());
@@ -535,8 +659,7 @@ void translatePrimeCLine(std::string& ln, std::ofstream& outfile) {
             ln = ln.replace(match.position(), match.length(), ppl);
         }
         
-        re = R"(\bIF\b *\((.*)\) *\{)";
-        if (std::regex_search(ln, match, re)) {
+        if (Patterns::IfStatement.search(ln, match)) {
             std::string statement, ppl;
             statement = trim_copy(match[1].str());
             closingScope.push_back("");
@@ -544,8 +667,7 @@ void translatePrimeCLine(std::string& ln, std::ofstream& outfile) {
             ln = ln.replace(match.position(), match.length(), ppl);
         }
         
-        re = R"(\bWHILE\b *\((.*)\) *\{)";
-        if (std::regex_search(ln, match, re)) {
+        if (Patterns::WhileStatement.search(ln, match)) {
             std::string statement, ppl;
             statement = trim_copy(match[1].str());
             closingScope.push_back("");
@@ -555,218 +677,296 @@ void translatePrimeCLine(std::string& ln, std::ofstream& outfile) {
         
         
         
-        re = R"(\b(?:REPEAT|DO)\b *\{)";
-        if (std::regex_search(ln, match, re)) {
+        if (Patterns::RepeatStatement.search(ln, match)) {
             closingScope.push_back("");
             ln = ln.replace(match.position(), match.length(), "REPEAT");
         }
 
     }
 
-    ln = regex_replace(ln, std::regex(R"( *:= *)"), " := ");
-    
+    ln = Patterns::SpacedAssignment.replace(ln, " := ");
     
-    simplifyCalculations(ln);
+    context.deferLine(ln, output.size(), Context::Remainder::Calculations);
+}
+
+// MARK: - Second Pass
+
+/*
+ Completes the rewriting of a line deferred by the first pass, as the first pass would have done,
+ other than leaving its strings blanked out. A line's strings are the only part of it not known
+ to the rest of its rewriting, so identical lines can share the one rewrite.
+ */
+void rewritePrimeCLine(Context::TLine& line, Profiler& profiler) {
+    std::string& ln = line.text;
     
+    if (Context::Remainder::Line == line.remainder) {
+        Profiler::Section section(profiler, Profiler::Stage::Types);
+        translatePrimeCTypes(ln);
+        
+        section.next(Profiler::Stage::Scope);
+        translatePrimeCSubscripts(ln);
+        
+        // PPL uses := instead of C's = for assignment. Converting all = to PPL style :=
+        ln = Patterns::Assignment.replace(ln, "$1 := ");
+        
+        translatePrimeCScopedSyntax(ln, line.scope);
+        
+        ln = Patterns::SpacedAssignment.replace(ln, " := ");
+    }
     
-    re = R"(\b([A-Za-z]\w*)\.push_back\((.*)\))";
-    ln = regex_replace(ln, re, "CONCAT($1,$2)▶$1");
+    if (Context::Remainder::Formatting != line.remainder) {
+        Profiler::Section section(profiler, Profiler::Stage::Calc);
+        simplifyCalculations(ln);
+        
+        
+        section.next(Profiler::Stage::Scope);
+        translatePrimeCListMethods(ln);
+    }
     
-    re = R"(\b([A-Za-z]\w*)\.front\(\))";
-    ln = regex_replace(ln, re, "$1(1)");
+    Profiler::Section section(profiler, Profiler::Stage::Formatting);
+    reformatPPLLine(ln, line.nestingLevel, line.scope);
+}
+
+/*
+ Lines deferred by the first pass are identical as far as the second pass is concerned if their
+ text is identical, with their strings blanked out, and they're at the same nesting level and
+ scope with as much of them left to rewrite.
+ */
+typedef struct TRewriteKey {
+    std::string_view text;
+    Context::Remainder remainder;
+    int nestingLevel;
+    Context::Scope scope;
+    
+    bool operator==(const TRewriteKey&) const = default;
+} TRewriteKey;
+
+typedef struct TRewriteKeyHash {
+    size_t operator()(const TRewriteKey& key) const {
+        uint64_t state = (uint64_t)key.nestingLevel << 8 | (uint64_t)key.scope << 4 | (uint64_t)key.remainder;
+        return Cache::hash(key.text, Cache::hash(std::string_view((const char *)&state, sizeof(state))));
+    }
+} TRewriteKeyHash;
+
+/*
+ Rewrites every line deferred by the first pass on a pool of `jobs` threads, each thread
+ taking the next batch of lines not yet started, then splices them into the output in order.
+ Any diagnostics raised are reported in the order of the lines that raised them.
+ 
+ Only the first of any identical lines gets rewritten, the rest take a copy of it, unless
+ rewriting it raised any diagnostics, which each line then raises for itself.
+ */
+void rewriteDeferredLines(UTF16Writer& output, Context& context, int jobs) {
+    const size_t batch = 64;
+    std::vector<Context::TLine>& lines = context.lines;
+    std::vector<size_t> first(lines.size());
+    std::vector<size_t> unique;
     
-    re = R"(\b([A-Za-z]\w*)\.back\(\))";
-    ln = regex_replace(ln, re, "$1(length($1))");
+    {
+        std::unordered_map<TRewriteKey, size_t, TRewriteKeyHash> seen;
+        seen.reserve(lines.size());
+        for (size_t i = 0; i < lines.size(); ++i) {
+            auto result = seen.try_emplace({lines[i].text, lines[i].remainder, lines[i].nestingLevel, lines[i].scope}, i);
+            first[i] = result.first->second;
+            if (result.second) unique.push_back(i);
+        }
+    }
     
-    re = R"(\b([A-Za-z]\w*)\.length\(\))";
-    ln = regex_replace(ln, re, "length($1)");
+    std::atomic<size_t> next = 0;
+    std::vector<Profiler> profilers(std::max(jobs, 1));
     
-    re = R"(\b([A-Za-z]\w*)\.at\((\d+)\))";
-    ln = regex_replace(ln, re, "$1($2)");
+    auto worker = [&](Profiler& profiler) {
+        profiler.enabled = context.profiler.enabled;
+        profiler.tracing = context.profiler.tracing;
+        
+        Context *current = Context::current();
+        Context::setCurrent(&context);
+        
+        for (size_t start = next.fetch_add(batch); start < unique.size(); start = next.fetch_add(batch)) {
+            size_t end = std::min(start + batch, unique.size());
+            for (size_t i = start; i < end; ++i) {
+                Context::setCurrentLine(&lines[unique[i]]);
+                rewritePrimeCLine(lines[unique[i]], profiler);
+            }
+        }
+        
+        Context::setCurrentLine(nullptr);
+        Context::setCurrent(current);
+    };
     
-    exit:
-    strings.restoreStrings(ln);
-    reformatPPLLine(ln);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < profilers.size() && i * batch < unique.size(); ++i) {
+        threads.emplace_back(worker, std::ref(profilers[i]));
+    }
+    worker(profilers.front());
+    for (auto& thread : threads) {
+        thread.join();
+    }
     
-    ln.append("\n");
-}
-
-void writeUTF16Line(const std::string& str, std::ofstream& outfile) {
-    for ( int n = 0; n < str.length(); n++) {
-        uint8_t *ascii = (uint8_t *)&str.at(n);
-        if (str.at(n) == '\r') continue;
+    context.rewriteMemo.lookups += lines.size();
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (first[i] == i) continue;
         
-        // Output as UTF-16LE
-        if (*ascii >= 0x80) {
-            uint16_t utf16 = utf8_to_utf16(&str.at(n));
-            
-#ifndef __LITTLE_ENDIAN__
-            utf16 = utf16 >> 8 | utf16 << 8;
-#endif
-            outfile.write((const char *)&utf16, 2);
-            if ((*ascii & 0b11100000) == 0b11000000) n++;
-            if ((*ascii & 0b11110000) == 0b11100000) n+=2;
-            if ((*ascii & 0b11111000) == 0b11110000) n+=3;
-        } else {
-            outfile.put(str.at(n));
-            outfile.put('\0');
+        if (lines[first[i]].messages) {
+            Context::setCurrentLine(&lines[i]);
+            rewritePrimeCLine(lines[i], profilers.front());
+            Context::setCurrentLine(nullptr);
+            continue;
         }
+        
+        lines[i].text = lines[first[i]].text;
+        context.rewriteMemo.hits++;
     }
-}
-
-void writeUTF16(const std::string& str, std::ofstream& outfile) {
-    std::istringstream stream(str);
-    std::string line;
     
-    while (std::getline(stream, line)) {
-        line.append("\n");
-        writeUTF16Line(line, outfile);
+    for (size_t i = 0; i <= threads.size(); ++i) {
+        context.profiler.merge(profilers[i]);
     }
+    
+    Profiler::Section section(context.profiler, Profiler::Stage::Output);
+    std::vector<std::pair<size_t, std::string_view>> insertions;
+    insertions.reserve(lines.size());
+    for (auto& line : lines) {
+        line.strings.restoreStrings(line.text);
+        line.text.append("\n");
+        
+        if (line.messages) context.log << line.messages->str();
+        insertions.push_back({line.offset, line.text});
+    }
+    output.splice(insertions);
 }
 
-bool isMultilineComment(const std::string str) {
-    std::regex re(R"(^ *\/*)");
-    return std::regex_search(str, re);
+// Each line written is terminated with a newline, as the text may or may not end with one.
+void writeUTF16(const std::string& str, UTF16Writer& output) {
+    if (str.empty()) return;
+    
+    output.write(str);
+    if (str.back() != '\n') output.write("\n", 1);
 }
 
-bool isPythonBlock(const std::string str) {
-    std::regex re(R"(^ *# *PYTHON *(\/\/.*)?$)");
-    return std::regex_search(str, re);
+bool isPythonBlock(std::string_view str) {
+    return Patterns::PythonBlock.search(str);
 }
 
-bool isPPLBlock(const std::string str) {
-    std::regex re(R"(^ *# *PPL *(\/\/.*)?$)");
-    return std::regex_search(str, re);
+bool isPPLBlock(std::string_view str) {
+    return Patterns::PPLBlock.search(str);
 }
 
-void writePPLBlock(std::ifstream& infile, std::ofstream& outfile) {
-    std::regex re(R"(^ *# *(END) *(?:\/\/.*)?$)");
-    std::string str;
+void writePPLBlock(Source& source, UTF16Writer& output) {
+    std::string_view line;
     
-    Singleton::shared()->incrementLineNumber();
-    
-    while(getline(infile, str)) {
-        if (std::regex_search(str, re)) {
-            Singleton::shared()->incrementLineNumber();
-            return;
-        }
+    while(source.getline(line)) {
+        if (Patterns::EndBlock.search(line)) return;
         
-        str.append("\n");
-        writeUTF16Line(str, outfile);
-        Singleton::shared()->incrementLineNumber();
+        output.write(line.data(), line.length());
+        output.write("\n", 1);
     }
 }
 
-void writePythonBlock(std::ifstream& infile, std::ofstream& outfile) {
-    std::regex re(R"(^ *# *(END) *(?:\/\/.*)?$)");
-    std::string str;
+void writePythonBlock(Source& source, UTF16Writer& output) {
+    std::string_view line;
     
-    writeUTF16Line("#PYTHON\n", outfile);
-    Singleton::shared()->incrementLineNumber();
+    output.write("#PYTHON\n");
     
-    while(getline(infile, str)) {
-        if (std::regex_search(str, re)) {
-            writeUTF16Line("#END\n", outfile);
-            Singleton::shared()->incrementLineNumber();
+    while(source.getline(line)) {
+        if (Patterns::EndBlock.search(line)) {
+            output.write("#END\n");
             return;
         }
         
-        str.append("\n");
-        writeUTF16Line(str, outfile);
-        Singleton::shared()->incrementLineNumber();
+        output.write(line.data(), line.length());
+        output.write("\n", 1);
     }
 }
 
 bool isBlockCommentStart(const std::string str) {
-    std::regex re(R"(^ *\/\* *)");
-    return std::regex_search(str, re);
+    return Patterns::BlockCommentStart.search(str);
 }
 
 void convertToLineComment(std::string& str) {
-    std::regex re(R"(^ *\/\* *)");
-    
-    str = std::regex_replace(str, re, "//");
+    str = Patterns::BlockCommentStart.replace(str, "//");
     str.append("\n");
 }
 
-void writeBlockAsLineComments(std::ifstream& infile, std::ofstream& outfile) {
-    std::regex re;
+void writeBlockAsLineComments(Source& source, UTF16Writer& output) {
+    std::string_view line;
     std::string str;
     
-    Singleton::shared()->incrementLineNumber();
-    
-    re = R"( *\*\/(.*)$)";
-    
-    while(getline(infile, str)) {
-        if (std::regex_search(str, re)) {
-            str = std::regex_replace(str, re, "//$1");
+    while(source.getline(line)) {
+        if (Patterns::BlockCommentEnd.search(line)) {
+            str = Patterns::BlockCommentEnd.replace(std::string(line), "//$1");
             str.append("\n");
-            writeUTF16Line(str, outfile);
-            Singleton::shared()->incrementLineNumber();
+            output.write(str);
             break;
         }
-        str.insert(0, "// ");
-        str.append("\n");
-        writeUTF16Line(str, outfile);
-        Singleton::shared()->incrementLineNumber();
+        output.write("// ", 3);
+        output.write(line.data(), line.length());
+        output.write("\n", 1);
     }
 }
 
-void translatePrimeCToPPL(const std::string& pathname, std::ofstream& outfile)
+void translatePrimeCToPPL(const std::string& pathname, UTF16Writer& output, Context& context)
 {
-    Singleton& singleton = *Singleton::shared();
-    std::ifstream infile;
-    std::regex re;
+    Source source;
+    std::string_view line;
     std::string utf8;
     std::string str;
-    std::string ppl;
-
-    singleton.pushPathname(pathname);
     
-    infile.open(pathname,std::ios::in);
-    if (!infile.is_open()) exit(2);
+    if (!source.open(pathname)) {
+        context.log << MessageType::Error << "unable to open '" << pathname << "'\n";
+        return;
+    }
+    context.pushSource(source);
     
-    writeUTF16(std::string("#pragma mode( separator(.,;) integer(h64) )\n"), outfile);
+    Profiler::File file(context.profiler, pathname);
+    Profiler::Section section(context.profiler, Profiler::Stage::Output);
+    writeUTF16(std::string("#pragma mode( separator(.,;) integer(h64) )\n"), output);
     
-    while(getline(infile, utf8)) {
-        if (isPythonBlock(utf8)) {
-            writePythonBlock(infile, outfile);
+    while(source.getline(line)) {
+        section.next(Profiler::Stage::Comments);
+        
+        if (isPythonBlock(line)) {
+            section.next(Profiler::Stage::Output);
+            writePythonBlock(source, output);
             continue;
         }
         
-        if (isPPLBlock(utf8)) {
-            writePPLBlock(infile, outfile);
+        if (isPPLBlock(line)) {
+            section.next(Profiler::Stage::Output);
+            writePPLBlock(source, output);
             continue;
         }
         
         // Convert any `/* comment */` to `// comment`
-        re = R"(\/\*(.*)(?:(\*\/)))";
-        utf8 = regex_replace(utf8, re, "//$1\n");
+        utf8 = line;
+        if (Patterns::InlineBlockComment.search(line)) {
+            utf8 = Patterns::InlineBlockComment.replace(utf8, "//$1\n");
+        }
         
         if (isBlockCommentStart(utf8)) {
             convertToLineComment(utf8);
-            writeUTF16Line(utf8, outfile);
-            writeBlockAsLineComments(infile, outfile);
+            section.next(Profiler::Stage::Output);
+            output.write(utf8);
+            writeBlockAsLineComments(source, output);
             continue;
         }
         
-        re = R"(\/\/.*$)";
-        utf8 = regex_replace(utf8, re, "");
-        
+        utf8 = Patterns::LineComment.replace(utf8, "");
         
-        std::istringstream iss;
-        iss.str(utf8);
-        
-        while(getline(iss, str)) {
-            translatePrimeCLine(str, outfile);
-            writeUTF16(str, outfile);
+        // The line may have been split in two by a `/* comment */`.
+        for (size_t start = 0, end; start < utf8.length(); start = end + 1) {
+            end = utf8.find('\n', start);
+            if (end == std::string::npos) end = utf8.length();
+            
+            str = utf8.substr(start, end - start);
+            translatePrimeCLine(str, output, context);
+            
+            section.next(Profiler::Stage::Output);
+            writeUTF16(str, output);
+            section.next(Profiler::Stage::Comments);
         }
-        
-        Singleton::shared()->incrementLineNumber();
     }
-   
-    infile.close();
-    singleton.popPathname();
+    
+    context.popSource();
 }
 
 
@@ -793,16 +993,26 @@ void help(void) {
     std::cout << "Copyright (C) 2023-" << YEAR << " Insoft. All rights reserved.\n";
     std::cout << "Insoft " << NAME << " version, " << VERSION_NUMBER << " (BUILD " << VERSION_CODE << ")\n";
     std::cout << "\n";
-    std::cout << "Usage: " << _basename << " <input-file> [-o <output-file>] [-b <flags>] [-l <pathname>]\n";
+    std::cout << "Usage: " << _basename << " <input-file>... [-o <output-file>] [-b <flags>] [-l <pathname>] [-j <jobs>] [-cache <directory>] [-trace <file>] [-O0]\n";
     std::cout << "\n";
     std::cout << "Options:\n";
     std::cout << "  -o <output-file>        Specify the filename for generated PPL code.\n";
     std::cout << "  -v                      Display detailed processing information.\n";
+    std::cout << "  -j <jobs>               Compile up to <jobs> input files, or lines of a single\n";
+    std::cout << "                          input file, at the same time.\n";
+    std::cout << "  -trace <file>           Write the time spent in each stage and file as Chrome\n";
+    std::cout << "                          trace-event JSON.\n";
+    std::cout << "  -cache <directory>      Reuse programs compiled before, unless any file they\n";
+    std::cout << "                          were built from has changed since.\n";
+    std::cout << "  -O0                     Leave the PPL as translated, without optimizing it.\n";
     std::cout << "\n";
     std::cout << "  Verbose Flags:\n";
     std::cout << "     a                    Aliases\n";
     std::cout << "     e                    Enumerator\n";
+    std::cout << "     o                    Optimizer statistics\n";
     std::cout << "     p                    Preprocessor\n";
+    std::cout << "     r                    Regular expression statistics\n";
+    std::cout << "     t                    Time spent in each stage and file, and memo hit rates\n";
     std::cout << "\n";
     std::cout << "Additional Commands:\n";
     std::cout << "  ansiart {-version | -help}\n";
@@ -811,9 +1021,219 @@ void help(void) {
 }
 
 
+// MARK: - Compile
+
+static std::string outputFilename(const std::string& in_filename) {
+    std::string out_filename = in_filename;
+    if (out_filename.rfind(".")) {
+        out_filename.replace(out_filename.rfind("."), out_filename.length() - out_filename.rfind("."), ".hpprgm");
+    }
+    return out_filename;
+}
+
+// Chrome trace-event JSON of every program compiled, written once all have been compiled.
+static std::ostringstream _trace;
+static bool _traceEmpty = true;
+static int _traceThreads = 0;
+static std::mutex _traceMutex;
+
+static void appendTrace(const Profiler& profiler, const std::string& name) {
+    std::lock_guard<std::mutex> lock(_traceMutex);
+    
+    // The lines rewritten on each thread of the second pass appear as threads of their own.
+    for (size_t thread = 0; thread < profiler.threadCount(); ++thread) {
+        int tid = ++_traceThreads;
+        
+        if (!_traceEmpty) _trace << ",\n";
+        _trace << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":\"" << name;
+        if (thread) _trace << " (rewrite " << thread << ")";
+        _trace << "\"}}";
+        _traceEmpty = false;
+        profiler.writeTrace(_trace, tid, _traceEmpty, thread);
+    }
+}
+
+static bool writeTrace(const std::string& filename) {
+    std::ofstream outfile;
+    outfile.open(filename, std::ios::out);
+    if (!outfile.is_open()) return false;
+    
+    outfile << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" << _trace.str() << "\n]}\n";
+    outfile.close();
+    return !outfile.fail();
+}
+
+// Everything a compiled program depends on, other than the files it was built from.
+static std::string cacheSettings(void) {
+    std::string settings = std::string(NAME) + " " + VERSION_NUMBER + " (BUILD " + VERSION_CODE + ")\n";
+    
+    settings += _path + "\n";
+    settings += _optimize ? "optimized\n" : "unoptimized\n";
+    for (const char **define = _predefined; *define; ++define) {
+        settings += std::string(*define) + "\n";
+    }
+    return settings;
+}
+
+/*
+ Compiles a single program, with all its diagnostics written to `log`. Returns false if
+ the program failed to compile, otherwise the number of lines compiled is put in `lines`.
+ */
+static bool compile(const std::string& in_filename, const std::string& out_filename, std::ostream& log, long& lines) {
+    std::string hpprgm;
+    if (_cache && _cache->lookup(in_filename, cacheSettings(), hpprgm)) {
+        std::ofstream outfile;
+        outfile.open(out_filename, std::ios::out | std::ios::binary);
+        outfile.write(hpprgm.data(), hpprgm.size());
+        outfile.close();
+        
+        if (!outfile.fail()) {
+            lines = 0;
+            log << "Compiled program found in cache\n";
+            log << "UTF-16LE File '" << out_filename << "' Succefuly Created.\n";
+            return true;
+        }
+    }
+    
+    Context context(log);
+    Context::setCurrent(&context);
+    
+    context.aliases.verbose = _verboseAliases;
+    context.preprocessor.verbose = _verbosePreprocessor;
+    context.preprocessor.path = _path;
+    context.profiler.enabled = _verboseTimings || !_traceFilename.empty();
+    context.profiler.tracing = !_traceFilename.empty();
+    
+    Match extension;
+    if (Patterns::FileExtension.search(in_filename, extension)) {
+        if (".ppl" == extension.str()) context.preprocessor.ppl = true;
+    }
+    
+    // The "hpprgm" file format requires UTF-16LE.
+    UTF16Writer output;
+    
+    // Start measuring time
+    Timer timer;
+    
+    for (const char **define = _predefined; *define; ++define) {
+        std::string str = *define;
+        context.preprocessor.parse(str);
+    }
+    
+    
+    
+    translatePrimeCToPPL(in_filename, output, context);
+    rewriteDeferredLines(output, context, _rewriteJobs);
+    
+    Optimizer optimizer;
+    optimizer.inlining = context.preprocessor.inlining;
+    if (_optimize && !context.failed) {
+        Profiler::Section section(context.profiler, Profiler::Stage::Optimizer);
+        std::string ppl = output.str();
+        optimizer.optimize(ppl);
+        output.clear();
+        output.write(ppl);
+    }
+    
+    // Stop measuring time and calculate the elapsed time.
+    long long elapsed_time = timer.elapsed();
+
+    
+    Context::setCurrent(nullptr);
+    
+    if (context.failed) {
+        log << "\e[48;5;160mERRORS\e[0m!\n";
+        remove(out_filename.c_str());
+        return false;
+    }
+    
+    if (!output.save(out_filename)) {
+        log << MessageType::Error << "unable to create '" << out_filename << "'\n";
+        return false;
+    }
+    
+    if (_cache) {
+        _cache->store(in_filename, cacheSettings(), context.dependencies, output.data());
+    }
+    
+    // Display elasps time in secononds, along with the throughput in lines per second.
+    lines = context.totalLineCount();
+    log << "Compiled in " << std::fixed << std::setprecision(2) << elapsed_time / 1e9 << " seconds";
+    log << " (" << lines << " lines, " << std::setprecision(0) << (elapsed_time ? lines / (elapsed_time / 1e9) : 0) << " lines/s)\n";
+    log << "UTF-16LE File '" << out_filename << "' Succefuly Created.\n";
+    
+    if (_verboseOptimizer) {
+        optimizer.printStatistics(log);
+    }
+    
+    if (_verboseTimings) {
+        log << "\n";
+        context.profiler.printTable(log);
+        
+        log << "\n" << std::left << std::setw(28) << "memo" << std::right
+            << std::setw(12) << "lookups" << std::setw(12) << "hits" << std::setw(8) << "%" << "\n";
+        for (const auto& memo : {std::make_pair("resolve", context.resolveMemo), std::make_pair("rewrite", context.rewriteMemo)}) {
+            log << std::left << std::setw(28) << memo.first << std::right
+                << std::setw(12) << memo.second.lookups << std::setw(12) << memo.second.hits
+                << std::setw(8) << std::fixed << std::setprecision(1) << (memo.second.lookups ? 100.0 * memo.second.hits / memo.second.lookups : 0) << "\n";
+        }
+    }
+    
+    if (context.profiler.tracing) {
+        appendTrace(context.profiler, basename(in_filename));
+    }
+    
+    return true;
+}
+
+/*
+ Compiles every input file on a pool of `jobs` threads, each thread taking the next input
+ that hasn't been started yet. The diagnostics of each program are held back until it has
+ finished, so the output of programs compiled at the same time never gets interleaved.
+ */
+static void compileAll(const std::vector<std::string>& inputs, int jobs) {
+    std::atomic<size_t> next = 0;
+    std::atomic<long> lines = 0;
+    std::atomic<int> compiled = 0;
+    std::mutex mutex;
+    
+    Timer timer;
+    
+    auto worker = [&]() {
+        for (size_t i = next++; i < inputs.size(); i = next++) {
+            std::ostringstream log;
+            long n = 0;
+            
+            if (compile(inputs[i], outputFilename(inputs[i]), log, n)) {
+                lines += n;
+                compiled++;
+            }
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            std::cout << inputs[i] << ":\n" << log.str() << "\n";
+        }
+    };
+    
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < (size_t)jobs && i < inputs.size(); ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    long long elapsed_time = timer.elapsed();
+    std::cout << "Compiled " << compiled << " of " << inputs.size() << " programs in " << std::fixed << std::setprecision(2) << elapsed_time / 1e9 << " seconds";
+    std::cout << " (" << lines << " lines, " << std::setprecision(0) << (elapsed_time ? lines / (elapsed_time / 1e9) : 0) << " lines/s)\n";
+}
+
+
 // MARK: - Main
 int main(int argc, char **argv) {
-    std::string in_filename, out_filename;
+    std::vector<std::string> inputs;
+    std::string out_filename;
+    int jobs = 1;
 
     if (argc == 1) {
         error();
@@ -859,8 +1279,11 @@ int main(int argc, char **argv) {
             }
             args = argv[++n];
             
-            if (args.find("a") != std::string::npos) Singleton::shared()->aliases.verbose = true;
-            if (args.find("p") != std::string::npos) preprocessor.verbose = true;
+            if (args.find("a") != std::string::npos) _verboseAliases = true;
+            if (args.find("p") != std::string::npos) _verbosePreprocessor = true;
+            if (args.find("r") != std::string::npos) _verbosePatterns = true;
+            if (args.find("t") != std::string::npos) _verboseTimings = true;
+            if (args.find("o") != std::string::npos) _verboseOptimizer = true;
         
             continue;
         }
@@ -870,79 +1293,74 @@ int main(int argc, char **argv) {
                 error();
                 return 0;
             }
-            preprocessor.path = std::string(argv[n]);
-            if (preprocessor.path.at(preprocessor.path.length() - 1) != '/') preprocessor.path.append("/");
+            _path = std::string(argv[n]);
+            if (_path.at(_path.length() - 1) != '/') _path.append("/");
             continue;
         }
         
-        in_filename = argv[n];
-        std::regex re(R"(.\w*$)");
-        std::smatch extension;
-        if (regex_search(in_filename, extension, re)) {
-            if (".ppl" == extension.str()) preprocessor.ppl = true;
+        if (args == "-trace") {
+            if (++n >= argc) {
+                error();
+                return 0;
+            }
+            _traceFilename = argv[n];
+            continue;
         }
-    }
-    
-    if (!out_filename.length()) {
-        out_filename = in_filename;
-        if (out_filename.rfind(".")) {
-            out_filename.replace(out_filename.rfind("."), out_filename.length() - out_filename.rfind("."), ".hpprgm");
+        
+        if (args == "-O0") {
+            _optimize = false;
+            continue;
         }
+        
+        if (args == "-cache") {
+            if (++n >= argc) {
+                error();
+                return 0;
+            }
+            _cache = new Cache(argv[n]);
+            continue;
+        }
+        
+        if (args == "-j") {
+            if (++n >= argc) {
+                error();
+                return 0;
+            }
+            jobs = atoi(argv[n]);
+            if (jobs < 1) jobs = std::thread::hardware_concurrency();
+            continue;
+        }
+        
+        inputs.push_back(argv[n]);
     }
     
-    info();
-    
-    
-    std::ofstream outfile;
-    outfile.open(out_filename, std::ios::out | std::ios::binary);
-    if(!outfile.is_open())
-    {
+    if (inputs.empty() || (inputs.size() > 1 && out_filename.length())) {
         error();
         return 0;
     }
     
-    // The "hpprgm" file format requires UTF-16LE.
-    outfile.put(0xFF);
-    outfile.put(0xFE);
-    
-    // Start measuring time
-    Timer timer;
-    
-    std::string str;
-    str = "#define __primec";
-    preprocessor.parse(str);
-    str = "#define __SCREEN G0";
-    preprocessor.parse(str);
-    str = "#define __SCREEN_WIDTH 320";
-    preprocessor.parse(str);
-    str = "#define __SCREEN_HEIGHT 240";
-    preprocessor.parse(str);
-    str = R"(#define __LIST_LIMIT 10000)";
-    preprocessor.parse(str);
-    str = R"(#define true 1)";
-    preprocessor.parse(str);
-    str = R"(#define false 0)";
-    preprocessor.parse(str);
-    
-    
+    if (!out_filename.length()) {
+        out_filename = outputFilename(inputs.front());
+    }
     
-    translatePrimeCToPPL(in_filename, outfile);
+    info();
     
-    // Stop measuring time and calculate the elapsed time.
-    long long elapsed_time = timer.elapsed();
-
+    if (inputs.size() == 1) {
+        long lines;
+        _rewriteJobs = jobs;
+        compile(inputs.front(), out_filename, std::cout, lines);
+    } else {
+        compileAll(inputs, jobs);
+    }
     
-    outfile.close();
+    if (_verbosePatterns) {
+        std::cout << "\n";
+        Pattern::dumpStatistics(std::cout);
+    }
     
-    if (hasErrors() == true) {
-        std::cout << "\e[48;5;160mERRORS\e[0m!\n";
-        remove(out_filename.c_str());
-        return 0;
+    if (!_traceFilename.empty() && !writeTrace(_traceFilename)) {
+        std::cout << MessageType::Error << "unable to create '" << _traceFilename << "'\n";
     }
-
-    // Display elasps time in secononds.
-    std::cout << "Compiled in " << std::fixed << std::setprecision(2) << elapsed_time / 1e9 << " seconds\n";
-    std::cout << "UTF-16LE File '" << out_filename << "' Succefuly Created.\n";
     
     
     
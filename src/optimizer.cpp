@@ -0,0 +1,2696 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "optimizer.hpp"
+#include "calc.hpp"
+#include "common.hpp"
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <string_view>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+using namespace pp;
+
+// MARK: - Tokens
+
+// What a token is to the structure of a statement, worked out once as the line is tokenized.
+enum Role : uint8_t {
+    Keyword         = 1 << 0,
+    OperatorWord    = 1 << 1,   // AND OR XOR NOT MOD
+    Opens           = 1 << 2,   // IF WHILE FOR REPEAT CASE
+    Closes          = 1 << 3,   // END UNTIL
+    OpeningBracket  = 1 << 4,
+    ClosingBracket  = 1 << 5,
+    Separator       = 1 << 6    // ; := ▶ and ,
+};
+
+// The precedence of a binary operator, from lowest to highest.
+enum Precedence : uint8_t {
+    None,
+    Or,
+    And,
+    Equality,
+    Relational,
+    Sum,
+    Product,
+    Power
+};
+
+typedef struct TToken {
+    enum class Type {
+        Name,
+        Number,
+        Integer,        // a PPL integer, eg. #FF:64h
+        String,
+        Symbol,
+        Comment
+    } type;
+    std::string_view text;
+    std::string_view space;     // the whitespace before it
+    uint8_t role = 0;
+    Precedence precedence = None;
+} TToken;
+
+typedef struct TLine {
+    std::string_view text;
+    std::vector<TToken> tokens;
+    std::string_view trailing;  // any whitespace after the last token
+    bool changed = false;       // text no longer matches the tokens
+    bool dirty = true;          // not yet folded since it last changed
+} TLine;
+
+/*
+ The text of every token, and line, is a view of either the program being optimized or of text
+ held here for as long as it's being optimized, on the thread optimizing it.
+ */
+static thread_local std::deque<std::string> _strings;
+
+static std::string_view hold(std::string str) {
+    _strings.push_back(std::move(str));
+    return _strings.back();
+}
+
+typedef Calc::TValue TValue;
+
+static bool isWordStart(const char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+}
+
+static bool isWordCharacter(const char c) {
+    return isWordStart(c) || (c >= '0' && c <= '9');
+}
+
+static bool isDigit(const char c) {
+    return c >= '0' && c <= '9';
+}
+
+static void classify(TToken& token) {
+    typedef struct TClass {
+        uint8_t role;
+        Precedence precedence;
+    } TClass;
+    
+    static const std::unordered_map<std::string_view, TClass> classes = {
+        {"BEGIN", {Keyword}}, {"END", {Keyword | Closes}}, {"EXPORT", {Keyword}}, {"LOCAL", {Keyword}},
+        {"CONST", {Keyword}}, {"RETURN", {Keyword}}, {"KILL", {Keyword}}, {"IF", {Keyword | Opens}},
+        {"THEN", {Keyword}}, {"ELSE", {Keyword}}, {"WHILE", {Keyword | Opens}}, {"DO", {Keyword}},
+        {"FOR", {Keyword | Opens}}, {"FROM", {Keyword}}, {"TO", {Keyword}}, {"DOWNTO", {Keyword}},
+        {"STEP", {Keyword}}, {"REPEAT", {Keyword | Opens}}, {"UNTIL", {Keyword | Closes}},
+        {"CASE", {Keyword | Opens}}, {"DEFAULT", {Keyword}}, {"BREAK", {Keyword}}, {"CONTINUE", {Keyword}},
+        
+        {"OR", {OperatorWord, Or}}, {"XOR", {OperatorWord, Or}}, {"AND", {OperatorWord, And}},
+        {"NOT", {OperatorWord}}, {"MOD", {OperatorWord, Product}},
+        
+        {"==", {0, Equality}}, {"≠", {0, Equality}}, {"=", {0, Equality}},
+        {"<", {0, Relational}}, {">", {0, Relational}}, {"≤", {0, Relational}}, {"≥", {0, Relational}},
+        {"+", {0, Sum}}, {"-", {0, Sum}}, {"*", {0, Product}}, {"/", {0, Product}}, {"^", {0, Power}},
+        
+        {"(", {OpeningBracket}}, {"[", {OpeningBracket}}, {"{", {OpeningBracket}},
+        {")", {ClosingBracket}}, {"]", {ClosingBracket}}, {"}", {ClosingBracket}},
+        {";", {Separator}}, {":=", {Separator}}, {"▶", {Separator}}, {",", {Separator}}
+    };
+    
+    if (token.type != TToken::Type::Name && token.type != TToken::Type::Symbol) return;
+    
+    auto it = classes.find(token.text);
+    if (it == classes.end()) return;
+    
+    // Words are only ever keywords and symbols only ever operators or punctuation.
+    if ((token.type == TToken::Type::Name) != isWordStart(token.text.front())) return;
+    token.role = it->second.role;
+    token.precedence = it->second.precedence;
+}
+
+static TToken makeToken(TToken::Type type, std::string_view text) {
+    TToken token = {type, text};
+    classify(token);
+    return token;
+}
+
+static void tokenize(TLine& line) {
+    std::string_view str = line.text;
+    size_t pos = 0;
+    size_t space = 0;
+    
+    line.tokens.clear();
+    while (pos < str.length()) {
+        char c = str[pos];
+        
+        if (c == ' ' || c == '\t') {
+            pos++;
+            continue;
+        }
+        
+        TToken token;
+        size_t start = pos;
+        
+        if (c == '/' && pos + 1 < str.length() && str[pos + 1] == '/') {
+            token.type = TToken::Type::Comment;
+            pos = str.length();
+        }
+        else if (c == '"') {
+            token.type = TToken::Type::String;
+            for (pos++; pos < str.length() && str[pos] != '"'; pos++) {
+                if (str[pos] == '\\' && pos + 1 < str.length()) pos++;
+            }
+            if (pos < str.length()) pos++;
+        }
+        else if (isDigit(c) || (c == '.' && pos + 1 < str.length() && isDigit(str[pos + 1]))) {
+            token.type = TToken::Type::Number;
+            while (pos < str.length() && isDigit(str[pos])) pos++;
+            if (pos < str.length() && str[pos] == '.') {
+                for (pos++; pos < str.length() && isDigit(str[pos]); pos++);
+            }
+            if (pos + 1 < str.length() && str[pos] == 'E') {
+                size_t exponent = pos + 1;
+                if (str[exponent] == '-' || str[exponent] == '+') exponent++;
+                if (exponent < str.length() && isDigit(str[exponent])) {
+                    for (pos = exponent; pos < str.length() && isDigit(str[pos]); pos++);
+                }
+            }
+        }
+        else if (c == '#') {
+            token.type = TToken::Type::Integer;
+            for (pos++; pos < str.length() && isWordCharacter(str[pos]); pos++);
+            if (pos + 1 < str.length() && str[pos] == ':' && isDigit(str[pos + 1])) {
+                for (pos++; pos < str.length() && isWordCharacter(str[pos]); pos++);
+            }
+        }
+        else if (isWordStart(c)) {
+            token.type = TToken::Type::Name;
+            while (pos < str.length() && isWordCharacter(str[pos])) pos++;
+        }
+        else if ((unsigned char)c >= 0x80) {
+            // A whole UTF-8 sequence, such as ≠ ≤ ≥ ▶ or π
+            token.type = TToken::Type::Symbol;
+            for (pos++; pos < str.length() && ((unsigned char)str[pos] & 0xC0) == 0x80; pos++);
+        }
+        else {
+            static const char *pairs[] = {":=", "==", "<=", ">=", "<>", "::", nullptr};
+            token.type = TToken::Type::Symbol;
+            pos++;
+            for (const char **pair = pairs; *pair; ++pair) {
+                if (str.compare(start, 2, *pair) == 0) {
+                    pos = start + 2;
+                    break;
+                }
+            }
+        }
+        
+        token.text = str.substr(start, pos - start);
+        token.space = str.substr(space, start - space);
+        classify(token);
+        line.tokens.push_back(token);
+        space = pos;
+    }
+    line.trailing = str.substr(space);
+}
+
+static void render(TLine& line) {
+    std::string text;
+    for (const TToken& token : line.tokens) {
+        text += token.space;
+        text += token.text;
+    }
+    text += line.trailing;
+    line.text = hold(std::move(text));
+    line.changed = false;
+}
+
+static TLine makeLine(std::string_view text) {
+    TLine line;
+    line.text = text;
+    tokenize(line);
+    return line;
+}
+
+template <size_t N>
+static bool isSymbol(const TToken& token, const char (&text)[N]) {
+    return token.type == TToken::Type::Symbol && token.text.length() == N - 1 && memcmp(token.text.data(), text, N - 1) == 0;
+}
+
+template <size_t N>
+static bool isWord(const TToken& token, const char (&text)[N]) {
+    return token.type == TToken::Type::Name && token.text.length() == N - 1 && memcmp(token.text.data(), text, N - 1) == 0;
+}
+
+static bool isKeyword(const TToken& token) {
+    return token.role & Keyword;
+}
+
+static bool isIdentifier(const TToken& token) {
+    return token.type == TToken::Type::Name && !(token.role & (Keyword | OperatorWord));
+}
+
+static bool opens(const TToken& token) {
+    return token.role & Opens;
+}
+
+static bool closes(const TToken& token) {
+    return token.role & Closes;
+}
+
+static bool isOpeningBracket(const TToken& token) {
+    return token.role & OpeningBracket;
+}
+
+static bool isClosingBracket(const TToken& token) {
+    return token.role & ClosingBracket;
+}
+
+// The index of the bracket closing the one at `index`, or the number of tokens should it be unclosed.
+static size_t matchingBracket(const std::vector<TToken>& tokens, size_t index) {
+    int depth = 0;
+    for (size_t i = index; i < tokens.size(); ++i) {
+        if (isOpeningBracket(tokens[i])) depth++;
+        if (isClosingBracket(tokens[i]) && --depth == 0) return i;
+    }
+    return tokens.size();
+}
+
+// True if the tokens of the line are exactly those given.
+static bool isLine(const TLine& line, std::initializer_list<const char *> texts) {
+    if (line.tokens.size() != texts.size()) return false;
+    
+    size_t i = 0;
+    for (const char *text : texts) {
+        const TToken& token = line.tokens[i++];
+        if (token.text != text || token.type == TToken::Type::String) return false;
+    }
+    return true;
+}
+
+// True if the line is a statement opening with `keyword`, up to the `closing` keyword at its end, eg. IF ... THEN
+static bool isHeaderLine(const TLine& line, const char *keyword, const char *closing) {
+    const std::vector<TToken>& tokens = line.tokens;
+    return tokens.size() > 2 && isKeyword(tokens.front()) && tokens.front().text == keyword && isKeyword(tokens.back()) && tokens.back().text == closing;
+}
+
+// MARK: - Values
+
+/*
+ The calculator holds reals to 12 significant digits, so a value is only ever folded should it
+ be held exactly by both the compiler and the calculator, otherwise folding it could change the
+ result of the program.
+ */
+static bool representable(const TValue& value) {
+    static const int64_t limit = 1000000000000;
+    
+    if (value.integer) return value.i > -limit && value.i < limit;
+    
+    std::string str;
+    if (!Calc::format(value, str) || strtod(str.c_str(), nullptr) != value.d) return false;
+    
+    size_t digits = 0;
+    bool leading = true;
+    for (char c : str) {
+        if (!isDigit(c) || (leading && c == '0')) continue;
+        leading = false;
+        digits++;
+    }
+    return digits <= 12;
+}
+
+static bool real(const TValue& value, double& d) {
+    d = value.integer ? (double)value.i : value.d;
+    return true;
+}
+
+static bool truth(const TValue& value) {
+    return value.integer ? value.i != 0 : value.d != 0;
+}
+
+static TValue boolean(bool b) {
+    TValue value;
+    value.i = b ? 1 : 0;
+    return value;
+}
+
+static bool number(std::string_view text, TValue& value) {
+    value = TValue();
+    
+    if (text.find_first_of(".E") == std::string::npos) {
+        for (char c : text) {
+            if (__builtin_mul_overflow(value.i, 10, &value.i) || __builtin_add_overflow(value.i, c - '0', &value.i)) return false;
+        }
+        return representable(value);
+    }
+    
+    value.integer = false;
+    value.d = strtod(std::string(text).c_str(), nullptr);
+    
+    // A real that is a whole number is treated as an integer, as the calculator makes no distinction.
+    if (value.d == trunc(value.d) && fabs(value.d) < 1e12) {
+        value.integer = true;
+        value.i = (int64_t)value.d;
+    }
+    return representable(value);
+}
+
+static bool power(const TValue& a, const TValue& b, TValue& result) {
+    result = TValue();
+    
+    if (a.integer && b.integer && b.i >= 0) {
+        result.i = 1;
+        for (int64_t n = 0; n < b.i; ++n) {
+            if (__builtin_mul_overflow(result.i, a.i, &result.i)) return false;
+        }
+        return true;
+    }
+    
+    double x, y;
+    real(a, x);
+    real(b, y);
+    result.integer = false;
+    result.d = pow(x, y);
+    return std::isfinite(result.d);
+}
+
+static bool evaluate(std::string_view op, const TValue& a, const TValue& b, TValue& result) {
+    double x, y;
+    
+    if (op == "+" || op == "-" || op == "*" || op == "/") return Calc::evaluate(op[0], a, b, result);
+    
+    // MOD is only folded for a positive divisor, the one case where every definition of it agrees.
+    if (op == "MOD") return (b.integer ? b.i > 0 : b.d > 0) && Calc::evaluate('%', a, b, result);
+    
+    if (op == "^") return power(a, b, result);
+    
+    if (op == "AND") result = boolean(truth(a) && truth(b));
+    else if (op == "OR") result = boolean(truth(a) || truth(b));
+    else if (op == "XOR") result = boolean(truth(a) != truth(b));
+    else {
+        real(a, x);
+        real(b, y);
+        if (op == "==" || op == "=") result = boolean(x == y);
+        else if (op == "≠") result = boolean(x != y);
+        else if (op == "<") result = boolean(x < y);
+        else if (op == ">") result = boolean(x > y);
+        else if (op == "≤") result = boolean(x <= y);
+        else if (op == "≥") result = boolean(x >= y);
+        else return false;
+    }
+    return true;
+}
+
+// The tokens of a value, in parentheses should it be negative and the operand of an operator.
+static std::vector<TToken> literal(const TValue& value, bool operand) {
+    std::vector<TToken> tokens;
+    std::string str;
+    
+    Calc::format(value, str);
+    if (str == "-0") str = "0";
+    
+    std::string_view text = hold(std::move(str));
+    if (text[0] != '-') {
+        tokens.push_back(makeToken(TToken::Type::Number, text));
+        return tokens;
+    }
+    
+    if (operand) tokens.push_back(makeToken(TToken::Type::Symbol, "("));
+    tokens.push_back(makeToken(TToken::Type::Symbol, "-"));
+    tokens.push_back(makeToken(TToken::Type::Number, text.substr(1)));
+    if (operand) tokens.push_back(makeToken(TToken::Type::Symbol, ")"));
+    return tokens;
+}
+
+// MARK: - Built-ins
+
+// The text of a value as a PPL integer of a word size of 64 bits, in the given base, eg. #FFFF00:64h
+static std::string_view integerText(const TValue& value, char base) {
+    int radix = base == 'h' ? 16 : base == 'd' ? 10 : base == 'o' ? 8 : 2;
+    std::string digits;
+    for (int64_t i = value.i; i > 0 || digits.empty(); i /= radix) digits.insert(digits.begin(), "0123456789ABCDEF"[i % radix]);
+    return hold("#" + digits + ":64" + base);
+}
+
+// The integer and fractional parts of a value, as the calculator gives them, exactly to 10 decimal places.
+static bool parts(const TValue& value, TValue& whole, TValue& fraction) {
+    std::string str;
+    if (value.integer) {
+        whole = value;
+        fraction = TValue();
+        return true;
+    }
+    if (!Calc::format(value, str)) return false;
+    
+    bool negative = str[0] == '-';
+    if (negative) str.erase(0, 1);
+    size_t point = str.find('.');
+    TValue i, f;
+    if (!number(str.substr(0, point), i) || !number(point == std::string::npos ? "0" : "0" + str.substr(point), f)) return false;
+    
+    if (!negative) {
+        whole = i;
+        fraction = f;
+        return true;
+    }
+    return Calc::evaluate('n', i, i, whole) && Calc::evaluate('n', f, f, fraction);
+}
+
+// Built-ins that may be evaluated by the compiler, should every argument be known.
+static bool isEvaluated(std::string_view name) {
+    static const std::unordered_set<std::string_view> names = {
+        "RGB", "BITAND", "BITOR", "BITXOR", "BITSL", "BITSR", "MIN", "MAX", "ABS", "IP", "FP",
+        "SIN", "COS", "TAN", "ASIN", "ACOS", "ATAN"
+    };
+    return names.count(name);
+}
+
+/*
+ Evaluates a call to a built-in that only ever returns a value of its arguments, with every
+ argument known. Should an argument be a PPL integer, `base` is that of the first, and only the
+ bitwise built-ins accept it, giving a PPL integer in that base. RGB gives one in hexadecimal,
+ as a colour, eg. RGB(255, 255, 0) is #FFFF00:64h.
+ 
+ The trigonometric functions are only evaluated where the result is the same whatever the
+ angle measure of the calculator, eg. SIN(0) or ACOS(1).
+ */
+static bool evaluateBuiltin(std::string_view name, const std::vector<TValue>& arguments, char& base, TValue& result) {
+    size_t count = arguments.size();
+    result = TValue();
+    
+    if (name == "BITAND" || name == "BITOR" || name == "BITXOR") {
+        if (count < 2) return false;
+        for (size_t n = 0; n < count; ++n) {
+            const TValue& argument = arguments[n];
+            if (!argument.integer || argument.i < 0) return false;
+            
+            if (n == 0) result.i = argument.i;
+            else if (name == "BITAND") result.i &= argument.i;
+            else if (name == "BITOR") result.i |= argument.i;
+            else result.i ^= argument.i;
+        }
+        return true;
+    }
+    
+    if (name == "BITSL" || name == "BITSR") {
+        if (count < 1 || count > 2 || !arguments[0].integer || arguments[0].i < 0 || !arguments[count - 1].integer) return false;
+        
+        int64_t shift = count == 2 ? arguments[1].i : 1;
+        if (shift < 0 || shift > 62) return false;
+        if (name == "BITSR") {
+            result.i = arguments[0].i >> shift;
+            return true;
+        }
+        if (arguments[0].i > (INT64_MAX >> shift)) return false;
+        result.i = arguments[0].i << shift;
+        return true;
+    }
+    
+    // The rest are only ever given reals.
+    if (base) return false;
+    
+    if (name == "RGB") {
+        if (count != 3) return false;
+        for (const TValue& argument : arguments) {
+            if (!argument.integer || argument.i < 0 || argument.i > 255) return false;
+            result.i = result.i << 8 | argument.i;
+        }
+        base = 'h';
+        return true;
+    }
+    
+    if (name == "MIN" || name == "MAX") {
+        if (count != 2) return false;
+        double a, b;
+        real(arguments[0], a);
+        real(arguments[1], b);
+        result = (name == "MIN") == (b < a) ? arguments[1] : arguments[0];
+        return true;
+    }
+    
+    if (count != 1) return false;
+    const TValue& argument = arguments[0];
+    
+    if (name == "ABS") {
+        result = argument;
+        return !(argument.integer ? argument.i < 0 : argument.d < 0) || Calc::evaluate('n', argument, argument, result);
+    }
+    
+    if (name == "IP" || name == "FP") {
+        TValue whole, fraction;
+        if (!parts(argument, whole, fraction)) return false;
+        result = name == "IP" ? whole : fraction;
+        return true;
+    }
+    
+    bool zero = !truth(argument);
+    if (name == "SIN" || name == "TAN" || name == "ASIN" || name == "ATAN") return zero;
+    if (name == "COS") {
+        result.i = 1;
+        return zero;
+    }
+    if (name == "ACOS") return argument.integer && argument.i == 1;
+    
+    return false;
+}
+
+// MARK: - Expressions
+
+typedef struct TExpression {
+    enum class Kind {
+        Value,
+        Opaque,     // a name, string, PPL integer, or anything else whose value isn't known
+        Unary,
+        Binary,
+        Call,       // a call, or a list, matrix or index, with the arguments as its children
+        Group
+    } kind;
+    std::string_view op;
+    size_t first = 0;           // the tokens spanned, from first up to last
+    size_t last = 0;
+    int children = 0;           // where its children start among those of the parser
+    int count = 0;              // and how many there are
+    bool constant = false;
+    char base = 0;              // should the value be a PPL integer, the letter of its base, eg. 'h'
+    TValue value;
+} TExpression;
+
+/*
+ A recursive-descent parser for PPL expressions, with the precedence of PPL from lowest to
+ highest:
+ 
+     or         := and (('OR' | 'XOR') and)*
+     and        := not ('AND' not)*
+     not        := 'NOT' not | equality
+     equality   := relational (('==' | '≠' | '=') relational)*
+     relational := sum (('<' | '>' | '≤' | '≥') sum)*
+     sum        := product (('+' | '-') product)*
+     product    := negation (('*' | '/' | 'MOD') negation)*
+     negation   := '-' negation | power
+     power      := postfix ('^' negation)?
+     postfix    := primary ('[' arguments ']')*
+     primary    := number | integer | string | name | name '(' arguments ')' | '(' or ')'
+                 | '{' arguments '}' | '[' arguments ']'
+ 
+ Every node is folded as it's built, should all its operands be constant. Each rule returns the
+ index of the node it built, or -1 should the tokens not be an expression.
+ */
+typedef struct TExpressionParser {
+    const std::vector<TToken> *tokens = nullptr;
+    size_t pos = 0;
+    size_t end = 0;
+    std::vector<TExpression> nodes;
+    std::vector<int> children;      // the children of every node, those of each node together
+    std::vector<int> arguments;     // the arguments of the calls being parsed
+} TExpressionParser;
+
+static int parseOr(TExpressionParser& parser);
+
+static const int *children(const TExpressionParser& parser, const TExpression& node) {
+    return parser.children.data() + node.children;
+}
+
+static void setChildren(TExpressionParser& parser, TExpression& node, std::initializer_list<int> children) {
+    node.children = (int)parser.children.size();
+    node.count = (int)children.size();
+    parser.children.insert(parser.children.end(), children);
+}
+
+static int addNode(TExpressionParser& parser, TExpression node) {
+    node.last = parser.pos;
+    parser.nodes.push_back(std::move(node));
+    return (int)parser.nodes.size() - 1;
+}
+
+template <size_t N>
+static bool accept(TExpressionParser& parser, const char (&text)[N]) {
+    if (parser.pos >= parser.end) return false;
+    
+    const TToken& token = (*parser.tokens)[parser.pos];
+    if (token.type != TToken::Type::Symbol && token.type != TToken::Type::Name) return false;
+    if (token.text.length() != N - 1 || memcmp(token.text.data(), text, N - 1) != 0) return false;
+    
+    parser.pos++;
+    return true;
+}
+
+static int addUnary(TExpressionParser& parser, const char *op, size_t first, int operand) {
+    if (operand < 0) return -1;
+    
+    TExpression node = {TExpression::Kind::Unary, op, first};
+    setChildren(parser, node, {operand});
+    
+    const TExpression& a = parser.nodes[operand];
+    if (a.constant) {
+        if (node.op == "NOT") {
+            node.value = boolean(!truth(a.value));
+            node.constant = true;
+        }
+        else {
+            node.constant = Calc::evaluate('n', a.value, a.value, node.value) && representable(node.value);
+        }
+    }
+    return addNode(parser, node);
+}
+
+static int addBinary(TExpressionParser& parser, std::string_view op, size_t first, int lhs, int rhs) {
+    if (lhs < 0 || rhs < 0) return -1;
+    
+    TExpression node = {TExpression::Kind::Binary, op, first};
+    setChildren(parser, node, {lhs, rhs});
+    
+    const TExpression& a = parser.nodes[lhs];
+    const TExpression& b = parser.nodes[rhs];
+    if (a.constant && b.constant) {
+        node.constant = evaluate(op, a.value, b.value, node.value) && representable(node.value);
+    }
+    return addNode(parser, node);
+}
+
+/*
+ Parses the arguments up to the given closing bracket, which may be none at all, making them,
+ along with any pushed since `start`, the children of the node.
+ */
+template <size_t N>
+static bool parseArguments(TExpressionParser& parser, TExpression& node, const char (&closing)[N], size_t start) {
+    if (!accept(parser, closing)) {
+        do {
+            int argument = parseOr(parser);
+            if (argument < 0) return false;
+            parser.arguments.push_back(argument);
+        } while (accept(parser, ","));
+        
+        if (!accept(parser, closing)) return false;
+    }
+    
+    // Calls within the arguments have taken theirs by now, so those left are all this node's.
+    node.children = (int)parser.children.size();
+    node.count = (int)(parser.arguments.size() - start);
+    parser.children.insert(parser.children.end(), parser.arguments.begin() + start, parser.arguments.end());
+    parser.arguments.resize(start);
+    return true;
+}
+
+// Folds a call to a built-in that only ever returns a value of its arguments, should every argument be known.
+static void foldCall(TExpressionParser& parser, TExpression& node) {
+    if (!isEvaluated(node.op)) return;
+    
+    std::vector<TValue> arguments;
+    char base = 0;
+    
+    for (int n = 0; n < node.count; ++n) {
+        const TExpression& argument = parser.nodes[children(parser, node)[n]];
+        if (!argument.constant && !argument.base) return;
+        if (!base) base = argument.base;
+        arguments.push_back(argument.value);
+    }
+    
+    TValue value;
+    if (!evaluateBuiltin(node.op, arguments, base, value)) return;
+    
+    // A PPL integer is kept as one, so isn't folded into any expression it's part of.
+    node.value = value;
+    node.base = base;
+    node.constant = !base && representable(value);
+}
+
+static int parsePrimary(TExpressionParser& parser) {
+    if (parser.pos >= parser.end) return -1;
+    
+    const TToken& token = (*parser.tokens)[parser.pos];
+    size_t first = parser.pos;
+    TExpression node = {TExpression::Kind::Opaque, token.text, first};
+    
+    if (token.type == TToken::Type::Number) {
+        parser.pos++;
+        if (number(token.text, node.value)) {
+            node.kind = TExpression::Kind::Value;
+            node.constant = true;
+        }
+        return addNode(parser, node);
+    }
+    
+    /*
+     A PPL integer is known only of the word size of 64 bits the built-ins are evaluated to, eg.
+     #FF:64h, its base being the letter at its end.
+     */
+    if (token.type == TToken::Type::Integer) {
+        parser.pos++;
+        std::string_view text = token.text;
+        if (text.size() > 4 && text.compare(text.size() - 4, 3, ":64") == 0 && Calc::convertPPLIntegerNumberToBase10(text, node.value) == text.size()) {
+            node.base = text.back();
+        }
+        return addNode(parser, node);
+    }
+    
+    if (token.type == TToken::Type::String || isSymbol(token, "π")) {
+        parser.pos++;
+        return addNode(parser, node);
+    }
+    
+    if (token.type == TToken::Type::Name) {
+        if (!isIdentifier(token)) return -1;
+        parser.pos++;
+        if (accept(parser, "(")) {
+            node.kind = TExpression::Kind::Call;
+            if (!parseArguments(parser, node, ")", parser.arguments.size())) return -1;
+            foldCall(parser, node);
+        }
+        return addNode(parser, node);
+    }
+    
+    if (accept(parser, "(")) {
+        int child = parseOr(parser);
+        if (child < 0 || !accept(parser, ")")) return -1;
+        
+        node.kind = TExpression::Kind::Group;
+        setChildren(parser, node, {child});
+        node.constant = parser.nodes[child].constant;
+        node.value = parser.nodes[child].value;
+        return addNode(parser, node);
+    }
+    
+    if (accept(parser, "{")) {
+        node.kind = TExpression::Kind::Call;
+        return parseArguments(parser, node, "}", parser.arguments.size()) ? addNode(parser, node) : -1;
+    }
+    
+    if (accept(parser, "[")) {
+        node.kind = TExpression::Kind::Call;
+        return parseArguments(parser, node, "]", parser.arguments.size()) ? addNode(parser, node) : -1;
+    }
+    
+    return -1;
+}
+
+static int parsePostfix(TExpressionParser& parser) {
+    size_t first = parser.pos;
+    int node = parsePrimary(parser);
+    
+    while (node >= 0 && accept(parser, "[")) {
+        TExpression index = {TExpression::Kind::Call, "[]", first};
+        size_t start = parser.arguments.size();
+        parser.arguments.push_back(node);
+        if (!parseArguments(parser, index, "]", start)) return -1;
+        node = addNode(parser, index);
+    }
+    return node;
+}
+
+static int parseNegation(TExpressionParser& parser);
+
+static int parsePower(TExpressionParser& parser) {
+    size_t first = parser.pos;
+    int node = parsePostfix(parser);
+    
+    if (node >= 0 && parser.pos < parser.end && (*parser.tokens)[parser.pos].precedence == Power) {
+        parser.pos++;
+        node = addBinary(parser, "^", first, node, parseNegation(parser));
+    }
+    return node;
+}
+
+static int parseNegation(TExpressionParser& parser) {
+    size_t first = parser.pos;
+    if (accept(parser, "-")) return addUnary(parser, "-", first, parseNegation(parser));
+    return parsePower(parser);
+}
+
+// Parses the left-associative operators of the given precedence.
+static int parseLeft(TExpressionParser& parser, int (*operand)(TExpressionParser&), Precedence precedence) {
+    size_t first = parser.pos;
+    int node = operand(parser);
+    
+    while (node >= 0 && parser.pos < parser.end && (*parser.tokens)[parser.pos].precedence == precedence) {
+        std::string_view op = (*parser.tokens)[parser.pos++].text;
+        node = addBinary(parser, op, first, node, operand(parser));
+    }
+    return node;
+}
+
+static int parseProduct(TExpressionParser& parser) {
+    return parseLeft(parser, parseNegation, Product);
+}
+
+static int parseSum(TExpressionParser& parser) {
+    return parseLeft(parser, parseProduct, Sum);
+}
+
+static int parseRelational(TExpressionParser& parser) {
+    return parseLeft(parser, parseSum, Relational);
+}
+
+static int parseEquality(TExpressionParser& parser) {
+    return parseLeft(parser, parseRelational, Equality);
+}
+
+static int parseNot(TExpressionParser& parser) {
+    size_t first = parser.pos;
+    if (accept(parser, "NOT")) return addUnary(parser, "NOT", first, parseNot(parser));
+    return parseEquality(parser);
+}
+
+static int parseAnd(TExpressionParser& parser) {
+    return parseLeft(parser, parseNot, And);
+}
+
+static int parseOr(TExpressionParser& parser) {
+    return parseLeft(parser, parseAnd, Or);
+}
+
+// Parses the tokens from first up to last as a single expression, returning the index of its root or -1.
+static int parse(TExpressionParser& parser, const std::vector<TToken>& tokens, size_t first, size_t last) {
+    parser.tokens = &tokens;
+    parser.pos = first;
+    parser.end = last;
+    parser.nodes.clear();
+    parser.children.clear();
+    parser.arguments.clear();
+    
+    int root = parseOr(parser);
+    return root >= 0 && parser.pos == last ? root : -1;
+}
+
+/*
+ Splits the tokens of a line into the expressions it's made up of, at each keyword, `;`, `:=`,
+ `▶` and `,` outside of any brackets, calling `f` with the tokens spanned by each.
+ */
+template <typename F>
+static void forEachExpression(const std::vector<TToken>& tokens, F f) {
+    size_t start = 0;
+    int depth = 0;
+    
+    for (size_t i = 0; i <= tokens.size(); ++i) {
+        bool boundary = i == tokens.size() || tokens[i].type == TToken::Type::Comment;
+        if (!boundary) {
+            const TToken& token = tokens[i];
+            if (isOpeningBracket(token)) depth++;
+            if (isClosingBracket(token)) depth--;
+            boundary = depth == 0 && (token.role & (Keyword | Separator));
+        }
+        if (!boundary) continue;
+        
+        if (i > start) f(start, i);
+        if (i < tokens.size() && tokens[i].type == TToken::Type::Comment) return;
+        start = i + 1;
+    }
+}
+
+// MARK: - Folding
+
+typedef struct TReplacement {
+    size_t first;
+    size_t last;
+    std::vector<TToken> tokens;
+} TReplacement;
+
+// A value already written as a number, possibly negated or within parentheses.
+static bool isLiteral(const TExpressionParser& parser, const TExpression& node) {
+    if (node.kind == TExpression::Kind::Value) return true;
+    if (node.kind == TExpression::Kind::Group) return isLiteral(parser, parser.nodes[*children(parser, node)]);
+    if (node.kind == TExpression::Kind::Unary && node.op == "-") return parser.nodes[*children(parser, node)].kind == TExpression::Kind::Value;
+    return false;
+}
+
+// Gathers the largest constant expressions that are yet to be folded.
+static void gatherConstants(const TExpressionParser& parser, int index, bool operand, std::vector<TReplacement>& replacements) {
+    const TExpression& node = parser.nodes[index];
+    
+    if (node.constant) {
+        if (!isLiteral(parser, node)) replacements.push_back({node.first, node.last, literal(node.value, operand)});
+        return;
+    }
+    if (node.kind == TExpression::Kind::Call && node.base) {
+        replacements.push_back({node.first, node.last, {makeToken(TToken::Type::Integer, integerText(node.value, node.base))}});
+        return;
+    }
+    
+    for (int n = 0; n < node.count; ++n) {
+        gatherConstants(parser, children(parser, node)[n], node.kind == TExpression::Kind::Unary || node.kind == TExpression::Kind::Binary, replacements);
+    }
+}
+
+// Replaces the given runs of tokens, which must not overlap, keeping the whitespace before each run.
+static void replaceTokens(TLine& line, std::vector<TReplacement>& replacements) {
+    if (replacements.empty()) return;
+    
+    std::sort(replacements.begin(), replacements.end(), [](const TReplacement& a, const TReplacement& b) {
+        return a.first > b.first;
+    });
+    
+    std::vector<TToken>& tokens = line.tokens;
+    for (TReplacement& replacement : replacements) {
+        std::string_view space = replacement.first < tokens.size() ? tokens[replacement.first].space : "";
+        if (!replacement.tokens.empty()) replacement.tokens.front().space = space;
+        tokens.erase(tokens.begin() + replacement.first, tokens.begin() + replacement.last);
+        tokens.insert(tokens.begin() + replacement.first, replacement.tokens.begin(), replacement.tokens.end());
+    }
+    line.changed = true;
+    line.dirty = true;
+}
+
+// Folds every constant expression of the line, returning the number folded.
+static long foldLine(TLine& line, TExpressionParser& parser) {
+    std::vector<TReplacement> replacements;
+    
+    forEachExpression(line.tokens, [&](size_t first, size_t last) {
+        int root = parse(parser, line.tokens, first, last);
+        if (root >= 0) gatherConstants(parser, root, false, replacements);
+    });
+    
+    long folded = replacements.size();
+    replaceTokens(line, replacements);
+    line.dirty = false;
+    return folded;
+}
+
+// MARK: - Functions
+
+typedef struct TFunction {
+    std::string_view name;
+    std::vector<std::string_view> parameters;
+    std::vector<TLine> lines;
+} TFunction;
+
+/*
+ Checks that every block opened within the body of a function is closed within it, as each
+ pass relies on finding the end of any block it looks into.
+ */
+static bool isStructured(const TFunction& function) {
+    int depth = 0;
+    for (const TLine& line : function.lines) {
+        for (const TToken& token : line.tokens) {
+            if (opens(token)) depth++;
+            if (closes(token) && --depth < 0) return false;
+        }
+    }
+    return depth == 0;
+}
+
+// The line closing the block opened on line `index`, or, should `alternative` be given, any ELSE line of it.
+static size_t endOfBlock(const TFunction& function, size_t index, size_t *alternative) {
+    int depth = 0;
+    
+    for (size_t i = index; i < function.lines.size(); ++i) {
+        const TLine& line = function.lines[i];
+        if (alternative && depth == 1 && isLine(line, {"ELSE"})) *alternative = i;
+        for (const TToken& token : line.tokens) {
+            if (opens(token)) depth++;
+            if (closes(token) && --depth == 0) return i;
+        }
+    }
+    return function.lines.size();
+}
+
+// MARK: - Constant Propagation
+
+typedef struct TOccurrence {
+    size_t line;
+    size_t token;
+    int region;
+} TOccurrence;
+
+typedef struct TVariable {
+    bool declared = false;      // declared with a value exactly once
+    bool local = false;         // declared by the function, rather than a global
+    std::vector<size_t> assignments;    // the lines assigning to it, other than where declared
+    bool unsafe = false;        // used as anything other than a value
+    TOccurrence definition;
+    std::vector<TOccurrence> uses;
+} TVariable;
+
+/*
+ A region is the run of statements of a block, such as the THEN or ELSE statements of an IF,
+ that executes as a whole. A value assigned within a region is only known to later statements
+ of that same region, or regions nested within it.
+ */
+typedef struct TRegions {
+    std::vector<int> parents = {-1};
+    
+    int add(int parent) {
+        parents.push_back(parent);
+        return (int)parents.size() - 1;
+    }
+    
+    bool within(int region, int ancestor) const {
+        for (; region >= 0; region = parents[region]) {
+            if (region == ancestor) return true;
+        }
+        return false;
+    }
+} TRegions;
+
+// Built-ins that assign to variables passed to them, or treat a name as a variable of their own.
+static bool assignsArguments(const TToken& token) {
+    static const std::unordered_set<std::string_view> names = {
+        "INPUT", "CHOOSE", "EDITLIST", "EDITMAT", "MAKELIST", "MAKEMAT", "∑", "Σ"
+    };
+    return names.count(token.text);
+}
+
+static std::unordered_map<std::string_view, TVariable> findVariables(const TFunction& function, TRegions& regions) {
+    typedef struct TBlock {
+        std::string_view keyword;
+        int region;
+    } TBlock;
+    
+    std::unordered_map<std::string_view, TVariable> variables;
+    std::vector<TBlock> blocks = {{"", 0}};
+    
+    for (size_t l = 0; l < function.lines.size(); ++l) {
+        const std::vector<TToken>& tokens = function.lines[l].tokens;
+        bool declaring = false;
+        int depth = 0;
+        int assigning = -1;     // the depth of the arguments of a built-in assigning to them
+        
+        for (size_t k = 0; k < tokens.size(); ++k) {
+            const TToken& token = tokens[k];
+            int region = blocks.back().region;
+            
+            if (isOpeningBracket(token)) {
+                depth++;
+                if (assigning < 0 && k > 0 && assignsArguments(tokens[k - 1])) assigning = depth;
+                continue;
+            }
+            if (isClosingBracket(token)) {
+                if (depth == assigning) assigning = -1;
+                depth--;
+                continue;
+            }
+            if (isSymbol(token, ";") && depth == 0) {
+                declaring = false;
+                continue;
+            }
+            
+            if (isKeyword(token)) {
+                if (token.text == "LOCAL" || token.text == "CONST") declaring = true;
+                
+                if (opens(token)) {
+                    std::string_view keyword = token.text == "IF" && blocks.back().keyword == "CASE" ? "CLAUSE" : token.text;
+                    blocks.push_back({keyword, regions.add(region)});
+                }
+                if ((token.text == "ELSE" && blocks.back().keyword == "IF") || (token.text == "DEFAULT" && blocks.back().keyword == "CASE")) {
+                    blocks.back().region = regions.add(regions.parents[region]);
+                }
+                if (closes(token) && blocks.size() > 1) blocks.pop_back();
+                continue;
+            }
+            
+            if (!isIdentifier(token)) continue;
+            
+            TVariable& variable = variables[token.text];
+            TOccurrence occurrence = {l, k, region};
+            const TToken *next = k + 1 < tokens.size() ? &tokens[k + 1] : nullptr;
+            const TToken *previous = k > 0 ? &tokens[k - 1] : nullptr;
+            
+            if (assigning >= 0 || (previous && (isSymbol(*previous, "▶") || isWord(*previous, "FOR")))) {
+                variable.assignments.push_back(l);
+                continue;
+            }
+            
+            // A name being declared by a LOCAL or CONST, rather than one within the value it's declared with.
+            bool declared = declaring && depth == 0 && previous && (isWord(*previous, "LOCAL") || isWord(*previous, "CONST") || isSymbol(*previous, ","));
+            if (declared) variable.local = true;
+            
+            if (next && isSymbol(*next, ":=")) {
+                if (declared && !variable.declared) {
+                    variable.declared = true;
+                    variable.definition = occurrence;
+                }
+                else {
+                    variable.assignments.push_back(l);
+                }
+                continue;
+            }
+            
+            if (declared) {
+                // Declared without a value.
+                variable.assignments.push_back(l);
+                continue;
+            }
+            
+            if (next && (isSymbol(*next, "(") || isSymbol(*next, "["))) {
+                size_t close = matchingBracket(tokens, k + 1);
+                if (close + 1 < tokens.size() && isSymbol(tokens[close + 1], ":=")) variable.assignments.push_back(l);
+                variable.unsafe = true;
+                continue;
+            }
+            
+            if ((previous && isSymbol(*previous, "::")) || (next && isSymbol(*next, "::"))) {
+                variable.unsafe = true;
+                continue;
+            }
+            
+            variable.uses.push_back(occurrence);
+        }
+    }
+    
+    return variables;
+}
+
+// The value a variable is declared with, should it be constant.
+static bool declaredValue(const TFunction& function, const TOccurrence& definition, TExpressionParser& parser, TValue& value) {
+    const std::vector<TToken>& tokens = function.lines[definition.line].tokens;
+    size_t first = definition.token + 2;
+    size_t last = first;
+    int depth = 0;
+    
+    for (; last < tokens.size(); ++last) {
+        if (isOpeningBracket(tokens[last])) depth++;
+        if (isClosingBracket(tokens[last])) depth--;
+        if (depth == 0 && (isSymbol(tokens[last], ",") || isSymbol(tokens[last], ";") || tokens[last].type == TToken::Type::Comment)) break;
+    }
+    
+    int root = parse(parser, tokens, first, last);
+    if (root < 0 || !parser.nodes[root].constant) return false;
+    value = parser.nodes[root].value;
+    return true;
+}
+
+/*
+ Removes the declaration of the variable at `index` from its LOCAL or CONST statement, and the
+ whole statement should it declare nothing else.
+ */
+static void removeDeclaration(TLine& line, size_t index) {
+    std::vector<TToken>& tokens = line.tokens;
+    size_t start = index;
+    while (start > 0 && !isWord(tokens[start], "LOCAL") && !isWord(tokens[start], "CONST")) start--;
+    
+    // The declarations of the statement, each from its first token up to the `,` or `;` after it.
+    std::vector<std::pair<size_t, size_t>> items;
+    size_t first = start + 1;
+    size_t end = tokens.size();
+    int depth = 0;
+    for (size_t i = first; i <= tokens.size(); ++i) {
+        if (i == tokens.size()) {
+            items.push_back({first, i});
+            break;
+        }
+        
+        if (isOpeningBracket(tokens[i])) depth++;
+        if (isClosingBracket(tokens[i])) depth--;
+        if (depth != 0) continue;
+        
+        if (isSymbol(tokens[i], ",")) {
+            items.push_back({first, i});
+            first = i + 1;
+        }
+        if (isSymbol(tokens[i], ";") || tokens[i].type == TToken::Type::Comment) {
+            items.push_back({first, i});
+            end = isSymbol(tokens[i], ";") ? i + 1 : i;
+            break;
+        }
+    }
+    
+    std::vector<TReplacement> replacements;
+    if (items.size() == 1) {
+        replacements.push_back({start, end, {}});
+    }
+    else {
+        for (size_t n = 0; n < items.size(); ++n) {
+            if (index < items[n].first || index >= items[n].second) continue;
+            
+            // The `,` after it goes with it, or the one before it should it be the last.
+            if (n + 1 < items.size()) replacements.push_back({items[n].first, items[n + 1].first, {}});
+            else replacements.push_back({items[n].first - 1, items[n].second, {}});
+        }
+    }
+    
+    std::string_view space = tokens[start].space;
+    bool leading = replacements.front().first == start;
+    replaceTokens(line, replacements);
+    if (leading && start < tokens.size()) tokens[start].space = space;
+}
+
+/*
+ Replaces every use of a variable that is only ever given a constant value, once, by its
+ declaration, with that value. A use is only replaced should it follow the declaration within
+ the same region, otherwise the variable may not yet, or no longer, hold that value.
+ */
+static bool propagateConstants(TFunction& function, TExpressionParser& parser, Optimizer::TStatistics& statistics) {
+    TRegions regions;
+    std::unordered_map<std::string_view, TVariable> variables = findVariables(function, regions);
+    
+    typedef struct TSubstitution {
+        TOccurrence occurrence;
+        TValue value;
+    } TSubstitution;
+    std::vector<TSubstitution> substitutions;
+    std::vector<TOccurrence> definitions;
+    
+    for (const auto& it : variables) {
+        const TVariable& variable = it.second;
+        if (!variable.declared || !variable.assignments.empty() || variable.unsafe) continue;
+        if (std::find(function.parameters.begin(), function.parameters.end(), it.first) != function.parameters.end()) continue;
+        
+        TValue value;
+        if (!declaredValue(function, variable.definition, parser, value)) continue;
+        
+        bool known = true;
+        for (const TOccurrence& use : variable.uses) {
+            if (use.line <= variable.definition.line || !regions.within(use.region, variable.definition.region)) known = false;
+        }
+        if (!known) continue;
+        
+        for (const TOccurrence& use : variable.uses) substitutions.push_back({use, value});
+        definitions.push_back(variable.definition);
+    }
+    
+    if (definitions.empty()) return false;
+    
+    // Last to first, so that replacing one leaves the positions of those before it intact.
+    std::sort(substitutions.begin(), substitutions.end(), [](const TSubstitution& a, const TSubstitution& b) {
+        return a.occurrence.line != b.occurrence.line ? a.occurrence.line > b.occurrence.line : a.occurrence.token > b.occurrence.token;
+    });
+    for (const TSubstitution& substitution : substitutions) {
+        std::vector<TReplacement> replacements = {{substitution.occurrence.token, substitution.occurrence.token + 1, literal(substitution.value, true)}};
+        replaceTokens(function.lines[substitution.occurrence.line], replacements);
+    }
+    statistics.propagated += substitutions.size();
+    
+    std::sort(definitions.begin(), definitions.end(), [](const TOccurrence& a, const TOccurrence& b) {
+        return a.line != b.line ? a.line > b.line : a.token > b.token;
+    });
+    for (const TOccurrence& definition : definitions) {
+        removeDeclaration(function.lines[definition.line], definition.token);
+    }
+    
+    // Lines left with nothing on them are removed.
+    function.lines.erase(std::remove_if(function.lines.begin(), function.lines.end(), [](const TLine& line) {
+        return line.changed && line.tokens.empty();
+    }), function.lines.end());
+    
+    return true;
+}
+
+// MARK: - Branches
+
+// Moves the lines of a branch kept in place of its IF out by a level.
+static void outdent(TLine& line) {
+    if (line.tokens.empty() || line.tokens.front().space.compare(0, INDENT_WIDTH, std::string(INDENT_WIDTH, ' ')) != 0) return;
+    line.tokens.front().space.remove_prefix(INDENT_WIDTH);
+    line.changed = true;
+}
+
+// The value of the condition between the first and last token of a line, should it be constant.
+static bool condition(const TLine& line, TExpressionParser& parser, bool& value) {
+    int root = parse(parser, line.tokens, 1, line.tokens.size() - 1);
+    if (root < 0 || !parser.nodes[root].constant) return false;
+    value = truth(parser.nodes[root].value);
+    return true;
+}
+
+/*
+ Removes the branches of IF statements that can never be taken, and WHILE loops that never
+ loop, as their condition is constant. Only statements whose IF, ELSE and END are each on a
+ line of their own are considered. A clause of a CASE is only ever removed, as whether any
+ clause before it is taken still decides whether it would be.
+ */
+static bool removeBranches(TFunction& function, TExpressionParser& parser, Optimizer::TStatistics& statistics) {
+    std::vector<TLine>& lines = function.lines;
+    std::vector<std::string_view> blocks;
+    bool removed = false;
+    
+    for (size_t i = 0; i < lines.size(); ++i) {
+        bool value;
+        bool clause = !blocks.empty() && blocks.back() == "CASE";
+        
+        if (isHeaderLine(lines[i], "IF", "THEN") && condition(lines[i], parser, value)) {
+            size_t alternative = 0;
+            size_t end = endOfBlock(function, i, clause ? nullptr : &alternative);
+            
+            if (end < lines.size() && isLine(lines[end], {"END", ";"}) && (!clause || !value)) {
+                size_t first = i, last = i;     // the lines kept, from first up to last
+                if (!clause) {
+                    if (value) {
+                        first = i + 1;
+                        last = alternative ? alternative : end;
+                    }
+                    else if (alternative) {
+                        first = alternative + 1;
+                        last = end;
+                    }
+                }
+                
+                for (size_t n = first; n < last; ++n) outdent(lines[n]);
+                lines.erase(lines.begin() + last, lines.begin() + end + 1);
+                lines.erase(lines.begin() + i, lines.begin() + first);
+                statistics.branches++;
+                removed = true;
+                i--;
+                continue;
+            }
+        }
+        
+        if (isHeaderLine(lines[i], "WHILE", "DO") && condition(lines[i], parser, value) && !value) {
+            size_t end = endOfBlock(function, i, nullptr);
+            if (end < lines.size() && isLine(lines[end], {"END", ";"})) {
+                lines.erase(lines.begin() + i, lines.begin() + end + 1);
+                statistics.branches++;
+                removed = true;
+                i--;
+                continue;
+            }
+        }
+        
+        for (const TToken& token : lines[i].tokens) {
+            if (opens(token)) blocks.push_back(token.text == "IF" && !blocks.empty() && blocks.back() == "CASE" ? "CLAUSE" : token.text);
+            if (closes(token) && !blocks.empty()) blocks.pop_back();
+        }
+    }
+    
+    return removed;
+}
+
+// MARK: - Loops
+
+// Built-ins that only ever return a value of their arguments, and so can be part of a loop's bound.
+static bool isPure(std::string_view name) {
+    static const std::unordered_set<std::string_view> names = {
+        "SIZE", "length", "DIM", "ABS", "MIN", "MAX", "IP", "FP", "CEILING", "FLOOR", "ROUND", "RGB"
+    };
+    return names.count(name);
+}
+
+// True if the variable is one of the function's own, being a parameter or declared by it.
+static bool isOwn(const TFunction& function, const TVariable& variable, std::string_view name) {
+    return variable.local || std::find(function.parameters.begin(), function.parameters.end(), name) != function.parameters.end();
+}
+
+// True if the variable is assigned to, or declared with a value, by any of the lines from first up to last.
+static bool isAssigned(const TVariable& variable, size_t first, size_t last) {
+    if (variable.declared && variable.definition.line >= first && variable.definition.line <= last) return true;
+    return std::any_of(variable.assignments.begin(), variable.assignments.end(), [first, last](size_t line) {
+        return line >= first && line <= last;
+    });
+}
+
+/*
+ True if the tokens from first up to last evaluate to the same value on every iteration of the
+ loop from line `begin` up to line `end`, only naming variables of the function that none of
+ those lines assign to, other than the loop's own.
+ */
+static bool isInvariant(const TFunction& function, const std::vector<TToken>& tokens, size_t first, size_t last, std::string_view variable,
+                        const std::unordered_map<std::string_view, TVariable>& variables, size_t begin, size_t end) {
+    for (size_t k = first; k < last; ++k) {
+        const TToken& token = tokens[k];
+        if (isKeyword(token) || isSymbol(token, "::") || isSymbol(token, "{")) return false;
+        if (!isIdentifier(token)) continue;
+        
+        if (k + 1 < last && isSymbol(tokens[k + 1], "(")) {
+            if (!isPure(token.text)) return false;
+            continue;
+        }
+        if (token.text == variable) return false;
+        
+        auto it = variables.find(token.text);
+        if (it == variables.end() || !isOwn(function, it->second, token.text) || isAssigned(it->second, begin, end)) return false;
+    }
+    return true;
+}
+
+// True if any CONTINUE from line `begin` up to line `end` would continue the loop they're within.
+static bool continues(const TFunction& function, size_t begin, size_t end) {
+    std::vector<bool> loops;
+    
+    for (size_t i = begin; i < end; ++i) {
+        for (const TToken& token : function.lines[i].tokens) {
+            if (opens(token)) loops.push_back(!isWord(token, "IF") && !isWord(token, "CASE"));
+            if (closes(token) && !loops.empty()) loops.pop_back();
+            if (isWord(token, "CONTINUE") && std::find(loops.begin(), loops.end(), true) == loops.end()) return true;
+        }
+    }
+    return false;
+}
+
+/*
+ Makes a FOR loop of each WHILE loop that counts a variable up, or down, to a bound, as a C for
+ loop is translated, eg.
+ 
+   i := 0; WHILE i<n DO
+     ...
+   i := i + 1; END;
+ 
+ becomes FOR i FROM 0 TO CEILING(n) - 1 DO, which the calculator runs without evaluating the
+ condition or the step as statements of its own. The variable and any variable of the bound
+ must be ones the function declares, which the loop's body never assigns to, as the bound is
+ only evaluated the once. A loop with a CONTINUE of its own is left as it is, as the step would
+ then no longer be skipped. A bound the variable must stay below, or above, is rounded to the
+ last whole number it reaches, so the variable must start as a whole number.
+ */
+static long makeForLoops(TFunction& function, TExpressionParser& parser) {
+    std::vector<TLine>& lines = function.lines;
+    TRegions regions;
+    std::unordered_map<std::string_view, TVariable> variables;
+    long made = 0;
+    
+    for (size_t i = 0; i < lines.size(); ++i) {
+        const std::vector<TToken>& tokens = lines[i].tokens;
+        if (tokens.size() < 9 || !isIdentifier(tokens[0]) || !isSymbol(tokens[1], ":=") || !isWord(tokens.back(), "DO")) continue;
+        
+        // The statement starting the variable, eg. `i := 0;`, is followed by its WHILE on the same line.
+        std::string_view variable = tokens[0].text;
+        size_t semicolon = 2;
+        for (int depth = 0; semicolon < tokens.size(); ++semicolon) {
+            if (isOpeningBracket(tokens[semicolon])) depth++;
+            if (isClosingBracket(tokens[semicolon])) depth--;
+            if (depth == 0 && isSymbol(tokens[semicolon], ";")) break;
+        }
+        if (semicolon + 4 >= tokens.size() || !isWord(tokens[semicolon + 1], "WHILE") || tokens[semicolon + 2].text != variable) continue;
+        
+        const TToken& comparison = tokens[semicolon + 3];
+        if (comparison.precedence != Relational) continue;
+        bool ascending = comparison.text == "<" || comparison.text == "≤";
+        bool inclusive = comparison.text == "≤" || comparison.text == "≥";
+        
+        // The bound is all that follows the comparison, any operator of it binding more tightly.
+        size_t first = semicolon + 4, last = tokens.size() - 1;
+        bool simple = true;
+        int depth = 0;
+        for (size_t k = first; k < last; ++k) {
+            if (isOpeningBracket(tokens[k])) depth++;
+            if (isClosingBracket(tokens[k])) depth--;
+            if (depth == 0 && (tokens[k].role & OperatorWord || (tokens[k].precedence != None && tokens[k].precedence <= Relational))) simple = false;
+        }
+        if (!simple) continue;
+        
+        // The statement stepping the variable, eg. `i := i + 1;`, is followed by the END of the loop.
+        size_t end = endOfBlock(function, i, nullptr);
+        if (end >= lines.size()) continue;
+        const std::vector<TToken>& closing = lines[end].tokens;
+        TValue step;
+        if (closing.size() != 8 || closing[0].text != variable || !isSymbol(closing[1], ":=") || closing[2].text != variable
+            || !isSymbol(closing[3], ascending ? "+" : "-") || !number(closing[4].text, step) || !step.integer || step.i <= 0
+            || !isSymbol(closing[5], ";") || !isWord(closing[6], "END") || !isSymbol(closing[7], ";")) continue;
+        
+        // Making a loop a FOR loop leaves every variable assigned on the same lines as before.
+        if (variables.empty()) variables = findVariables(function, regions);
+        auto it = variables.find(variable);
+        if (it == variables.end() || it->second.unsafe) continue;
+        if (!isOwn(function, it->second, variable) || isAssigned(it->second, i + 1, end - 1)) continue;
+        
+        if (!isInvariant(function, tokens, first, last, variable, variables, i, end) || continues(function, i + 1, end)) continue;
+        
+        int root = parse(parser, tokens, 2, semicolon);
+        if (root < 0) continue;
+        bool whole = parser.nodes[root].constant && parser.nodes[root].value.integer;
+        
+        root = parse(parser, tokens, first, last);
+        if (root < 0) continue;
+        
+        // The bound, rounded to the last whole number the variable can reach should it not be inclusive.
+        std::vector<TToken> bound;
+        if (inclusive) {
+            bound.assign(tokens.begin() + first, tokens.begin() + last);
+        }
+        else if (!whole) {
+            continue;
+        }
+        else if (parser.nodes[root].constant) {
+            TValue value = parser.nodes[root].value;
+            if (!value.integer) {
+                if (!(std::fabs(value.d) < 1e12)) continue;
+                value.i = (int64_t)(ascending ? std::ceil(value.d) : std::floor(value.d));
+                value.integer = true;
+            }
+            value.i += ascending ? -1 : 1;
+            if (!representable(value)) continue;
+            bound = literal(value, false);
+        }
+        else {
+            bound.push_back(makeToken(TToken::Type::Name, ascending ? "CEILING" : "FLOOR"));
+            bound.push_back(makeToken(TToken::Type::Symbol, "("));
+            bound.insert(bound.end(), tokens.begin() + first, tokens.begin() + last);
+            bound[2].space = "";
+            bound.push_back(makeToken(TToken::Type::Symbol, ")"));
+            bound.push_back(makeToken(TToken::Type::Symbol, ascending ? "-" : "+"));
+            bound.back().space = " ";
+            bound.push_back(makeToken(TToken::Type::Number, "1"));
+            bound.back().space = " ";
+        }
+        bound.front().space = " ";
+        
+        std::vector<TToken> header;
+        auto add = [&header](TToken token, std::string_view space) {
+            token.space = space;
+            header.push_back(token);
+        };
+        add(makeToken(TToken::Type::Name, "FOR"), tokens[0].space);
+        add(tokens[0], " ");
+        add(makeToken(TToken::Type::Name, "FROM"), " ");
+        for (size_t k = 2; k < semicolon; ++k) add(tokens[k], k == 2 ? " " : tokens[k].space);
+        add(makeToken(TToken::Type::Name, ascending ? "TO" : "DOWNTO"), " ");
+        header.insert(header.end(), bound.begin(), bound.end());
+        if (step.i != 1) {
+            add(makeToken(TToken::Type::Name, "STEP"), " ");
+            add(closing[4], " ");
+        }
+        add(tokens.back(), " ");
+        
+        lines[i].tokens = std::move(header);
+        lines[i].changed = lines[i].dirty = true;
+        
+        // The step is left to the FOR, leaving the END on its own.
+        std::vector<TToken> statement = {closing[6], closing[7]};
+        statement.front().space = closing[0].space;
+        lines[end].tokens = std::move(statement);
+        lines[end].changed = lines[end].dirty = true;
+        made++;
+    }
+    
+    return made;
+}
+
+/*
+ A FOR loop, whose FOR, and END, are each on a line of their own, its range and any step given
+ by the tokens of the FOR between FROM, TO or DOWNTO, STEP and DO.
+ */
+typedef struct TForLoop {
+    std::string_view variable;
+    size_t to;                  // the TO, or DOWNTO
+    size_t step;                // the STEP, or the DO should there be none
+    size_t end;                 // the line of its END
+    bool descending;
+    bool own;                   // the range is given by the variable itself
+} TForLoop;
+
+static bool isForLoop(const TFunction& function, size_t index, TForLoop& loop) {
+    const std::vector<TToken>& tokens = function.lines[index].tokens;
+    if (tokens.size() < 7 || !isWord(tokens[0], "FOR") || !isIdentifier(tokens[1]) || !isWord(tokens[2], "FROM") || !isWord(tokens.back(), "DO")) return false;
+    
+    loop = {tokens[1].text, 0, tokens.size() - 1, 0, false, false};
+    int depth = 0;
+    for (size_t k = 3; k < tokens.size() - 1; ++k) {
+        if (isOpeningBracket(tokens[k])) depth++;
+        if (isClosingBracket(tokens[k])) depth--;
+        if (isIdentifier(tokens[k]) && tokens[k].text == loop.variable) loop.own = true;
+        if (depth != 0) continue;
+        if (!loop.to && (isWord(tokens[k], "TO") || isWord(tokens[k], "DOWNTO"))) loop.to = k;
+        if (isWord(tokens[k], "STEP")) loop.step = k;
+    }
+    if (loop.to <= 3 || loop.step <= loop.to + 1 || loop.step + 1 == tokens.size() - 1) return false;
+    loop.descending = isWord(tokens[loop.to], "DOWNTO");
+    
+    loop.end = endOfBlock(function, index, nullptr);
+    return loop.end < function.lines.size() && isLine(function.lines[loop.end], {"END", ";"});
+}
+
+// MARK: - Index Offsets
+
+/*
+ True if no operator between the first and last token, outside of brackets, binds any less
+ tightly than + and -, so that one can be added to or taken from it as it is.
+ */
+static bool isSum(const std::vector<TToken>& tokens, size_t first, size_t last) {
+    int depth = 0;
+    for (size_t k = first; k < last; ++k) {
+        if (isOpeningBracket(tokens[k])) depth++;
+        if (isClosingBracket(tokens[k])) depth--;
+        if (depth != 0) continue;
+        if (isWord(tokens[k], "NOT") || (tokens[k].precedence != None && tokens[k].precedence < Sum)) return false;
+    }
+    return true;
+}
+
+// The tokens from first up to last as an expression one greater.
+static std::vector<TToken> increment(const std::vector<TToken>& tokens, size_t first, size_t last, TExpressionParser& parser) {
+    int root = parse(parser, tokens, first, last);
+    TValue one = {true, 1}, value;
+    
+    if (root >= 0 && parser.nodes[root].constant && evaluate("+", parser.nodes[root].value, one, value) && representable(value)) {
+        return literal(value, false);
+    }
+    
+    // A bound rounded down to the last whole number before it, eg. CEILING(n) - 1, is just that.
+    bool sum = isSum(tokens, first, last);
+    if (sum && last - first > 2 && isSymbol(tokens[last - 2], "-") && tokens[last - 1].text == "1") {
+        return std::vector<TToken>(tokens.begin() + first, tokens.begin() + last - 2);
+    }
+    
+    std::vector<TToken> result;
+    if (!sum) result.push_back(makeToken(TToken::Type::Symbol, "("));
+    result.insert(result.end(), tokens.begin() + first, tokens.begin() + last);
+    if (!sum) {
+        result[1].space = "";
+        result.push_back(makeToken(TToken::Type::Symbol, ")"));
+    }
+    result.push_back(makeToken(TToken::Type::Symbol, "+"));
+    result.back().space = " ";
+    result.push_back(makeToken(TToken::Type::Number, "1"));
+    result.back().space = " ";
+    return result;
+}
+
+/*
+ True if the variable is only ever used by the function as the variable of its FOR loops, other
+ than where it's declared, so that what it's left holding by the loop from line `begin` up to
+ line `end` is never read.
+ */
+static bool onlyCounts(const TFunction& function, std::string_view variable, size_t begin, size_t end) {
+    const std::vector<TLine>& lines = function.lines;
+    std::vector<std::pair<size_t, size_t>> loops;
+    
+    for (size_t i = 0; i < lines.size(); ++i) {
+        const std::vector<TToken>& tokens = lines[i].tokens;
+        if (tokens.size() < 2 || !isWord(tokens[0], "FOR") || tokens[1].text != variable) continue;
+        
+        size_t last = endOfBlock(function, i, nullptr);
+        if (i < begin && last >= end) return false;
+        loops.push_back({i, last});
+    }
+    
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (std::any_of(loops.begin(), loops.end(), [i](const std::pair<size_t, size_t>& loop) {
+            return i >= loop.first && i <= loop.second;
+        })) continue;
+        
+        const std::vector<TToken>& tokens = lines[i].tokens;
+        bool declaring = !tokens.empty() && isWord(tokens[0], "LOCAL");
+        int depth = 0;
+        for (size_t k = 0; k < tokens.size(); ++k) {
+            if (isOpeningBracket(tokens[k])) depth++;
+            if (isClosingBracket(tokens[k])) depth--;
+            if (isSymbol(tokens[k], ";") && depth == 0) declaring = false;
+            if (!isIdentifier(tokens[k]) || tokens[k].text != variable) continue;
+            if (!declaring || depth != 0 || !(isWord(tokens[k - 1], "LOCAL") || isSymbol(tokens[k - 1], ","))) return false;
+        }
+    }
+    return true;
+}
+
+/*
+ Finds each index of a list, or matrix, by the variable of the loop as the subscripts of C are
+ translated, eg. a[(i) + 1] or a[(i - 1) + 1], returning false should the variable be used as
+ anything else by the lines from first up to last.
+ */
+static bool findOffsets(const TFunction& function, std::string_view variable, size_t first, size_t last,
+                        std::vector<std::vector<TReplacement>>& offsets) {
+    offsets.assign(last - first, {});
+    
+    for (size_t i = first; i < last; ++i) {
+        const std::vector<TToken>& tokens = function.lines[i].tokens;
+        std::vector<bool> subscripts;
+        
+        for (size_t k = 0; k < tokens.size(); ++k) {
+            const TToken& token = tokens[k];
+            
+            if (isSymbol(token, "(") && k > 0 && (isSymbol(tokens[k - 1], "[") || (isSymbol(tokens[k - 1], ",") && !subscripts.empty() && subscripts.back()))) {
+                // (i), (i + 1) or (i - 1), followed by + 1 then the ] or , after the index.
+                size_t close = k + 2;
+                if (close + 1 < tokens.size() && (isSymbol(tokens[close], "+") || isSymbol(tokens[close], "-")) && tokens[close + 1].type == TToken::Type::Number) close += 2;
+                if (k + 1 < tokens.size() && tokens[k + 1].text == variable && close + 3 < tokens.size() && isSymbol(tokens[close], ")")
+                    && isSymbol(tokens[close + 1], "+") && tokens[close + 2].text == "1" && (isSymbol(tokens[close + 3], "]") || isSymbol(tokens[close + 3], ","))) {
+                    offsets[i - first].push_back({k, close + 3, std::vector<TToken>(tokens.begin() + k + 1, tokens.begin() + close)});
+                    k = close + 2;
+                    continue;
+                }
+            }
+            
+            if (isOpeningBracket(token)) subscripts.push_back(isSymbol(token, "["));
+            if (isClosingBracket(token) && !subscripts.empty()) subscripts.pop_back();
+            if (isIdentifier(token) && token.text == variable) return false;
+        }
+    }
+    return true;
+}
+
+/*
+ A list is indexed from one, so every index of C by the variable of a loop has one added to it
+ each time it's evaluated. Should the variable only be used as such an index, the loop instead
+ counts from one more to one more, leaving the variable as the index itself.
+ */
+static long removeIndexOffsets(TFunction& function, TExpressionParser& parser) {
+    std::vector<TLine>& lines = function.lines;
+    std::vector<std::vector<TReplacement>> offsets;
+    long removed = 0;
+    
+    for (size_t i = 0; i < lines.size(); ++i) {
+        TForLoop loop;
+        if (!isForLoop(function, i, loop) || loop.own) continue;
+        
+        const std::vector<TToken>& tokens = lines[i].tokens;
+        size_t to = loop.to, step = loop.step, end = loop.end;
+        if (!findOffsets(function, loop.variable, i + 1, end, offsets) || !onlyCounts(function, loop.variable, i, end)) continue;
+        
+        size_t count = 0;
+        for (const std::vector<TReplacement>& replacements : offsets) count += replacements.size();
+        if (!count) continue;
+        
+        std::vector<TReplacement> bounds = {
+            {3, to, increment(tokens, 3, to, parser)},
+            {to + 1, step, increment(tokens, to + 1, step, parser)}
+        };
+        replaceTokens(lines[i], bounds);
+        for (size_t n = 0; n < offsets.size(); ++n) replaceTokens(lines[i + 1 + n], offsets[n]);
+        removed += count;
+    }
+    
+    return removed;
+}
+
+// MARK: - Preallocation
+
+// A name for a variable of the function's own, not yet used by it, nor taken, eg. items_size.
+static std::string uniqueName(const TFunction& function, std::string_view base, const std::vector<std::string>& taken = {}) {
+    std::unordered_set<std::string_view> names(taken.begin(), taken.end());
+    for (const TLine& line : function.lines) {
+        for (const TToken& token : line.tokens) {
+            if (isIdentifier(token)) names.insert(token.text);
+        }
+    }
+    names.insert(function.parameters.begin(), function.parameters.end());
+    
+    std::string name(base);
+    for (int n = 2; names.count(name); ++n) name = std::string(base) + std::to_string(n);
+    return name;
+}
+
+// The number of times a FOR loop loops, should its range and step be constant.
+static bool tripCount(const std::vector<TToken>& tokens, const TForLoop& loop, TExpressionParser& parser, int64_t& count) {
+    TValue values[3] = {{true, 0}, {true, 0}, {true, 1}};
+    size_t bounds[][2] = {{3, loop.to}, {loop.to + 1, loop.step}, {loop.step + 1, tokens.size() - 1}};
+    
+    for (int n = 0; n < 3; ++n) {
+        if (bounds[n][0] >= bounds[n][1]) continue;
+        int root = parse(parser, tokens, bounds[n][0], bounds[n][1]);
+        if (root < 0 || !parser.nodes[root].constant || !parser.nodes[root].value.integer) return false;
+        values[n] = parser.nodes[root].value;
+    }
+    if (values[2].i <= 0) return false;
+    
+    int64_t range = loop.descending ? values[0].i - values[1].i : values[1].i - values[0].i;
+    count = range < 0 ? 0 : range / values[2].i + 1;
+    return true;
+}
+
+// True if the tokens from first up to last are only ever a number, made of numbers and the loop's variable.
+static bool isScalar(const std::vector<TToken>& tokens, size_t first, size_t last, std::string_view variable) {
+    for (size_t k = first; k < last; ++k) {
+        const TToken& token = tokens[k];
+        
+        switch (token.type) {
+            case TToken::Type::Number:
+            case TToken::Type::Integer:
+                continue;
+                
+            case TToken::Type::Name:
+                if (token.text == variable || isWord(token, "MOD")) continue;
+                if (k + 1 < last && isSymbol(tokens[k + 1], "(") && isPure(token.text) && !isWord(token, "SIZE") && !isWord(token, "DIM") && !isWord(token, "length")) continue;
+                return false;
+                
+            case TToken::Type::Symbol:
+                if (isSymbol(token, "(") || isSymbol(token, ")") || isSymbol(token, ",") || token.precedence >= Sum) continue;
+                return false;
+                
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+/*
+ The statement a list is appended to by, eg. `CONCAT(items, x) ▶ items;`, as a push_back of C is
+ translated, giving the token after the list, should the line be that statement alone.
+ */
+static bool isAppend(const std::vector<TToken>& tokens, std::string_view& list) {
+    if (tokens.size() < 9 || !isWord(tokens[0], "CONCAT") || !isSymbol(tokens[1], "(") || !isIdentifier(tokens[2]) || !isSymbol(tokens[3], ",")) return false;
+    
+    size_t n = tokens.size();
+    if (matchingBracket(tokens, 1) != n - 4 || !isSymbol(tokens[n - 3], "▶") || tokens[n - 2].text != tokens[2].text || !isSymbol(tokens[n - 1], ";")) return false;
+    list = tokens[2].text;
+    return true;
+}
+
+/*
+ Every CONCAT of a list with a value copies the whole list, so a loop appending to a list each
+ time it loops takes time in proportion to the square of the list's final size. Should the loop
+ loop a known number of times, appending a number exactly once each time, the list is instead
+ extended the once beforehand, each value stored in place, eg.
+ 
+   LOCAL items_size := SIZE(items);
+   CONCAT(items, MAKELIST(0,1,10)) ▶ items;
+   FOR i FROM 0 TO 9 DO
+     items_size := items_size + 1; items[items_size] := i * 2;
+   END;
+ 
+ with items_size standing in for the size of the list within the loop. The loop must not leave
+ early, and nothing within it may use the list as a whole, as it then holds zeros not yet stored.
+ */
+static long preallocateLists(TFunction& function, TExpressionParser& parser) {
+    std::vector<TLine>& lines = function.lines;
+    TRegions regions;
+    std::unordered_map<std::string_view, TVariable> variables;
+    long preallocated = 0;
+    
+    for (size_t i = 0; i < lines.size(); ++i) {
+        TForLoop loop;
+        int64_t count;
+        if (!isForLoop(function, i, loop) || !tripCount(lines[i].tokens, loop, parser, count) || count < 1 || count > 10000) continue;
+        
+        size_t append = 0;
+        std::string_view list;
+        bool leaves = false;
+        int depth = 0;
+        for (size_t n = i + 1; n < loop.end; ++n) {
+            std::string_view name;
+            if (depth == 0 && isAppend(lines[n].tokens, name)) {
+                if (append) leaves = true;
+                append = n;
+                list = name;
+            }
+            for (const TToken& token : lines[n].tokens) {
+                if (opens(token)) depth++;
+                if (closes(token)) depth--;
+                if (isWord(token, "BREAK") || isWord(token, "CONTINUE") || isWord(token, "RETURN") || isWord(token, "KILL")) leaves = true;
+            }
+        }
+        if (!append || leaves) continue;
+        
+        if (variables.empty()) variables = findVariables(function, regions);
+        auto it = variables.find(list);
+        if (it == variables.end() || !isOwn(function, it->second, list)) continue;
+        
+        const std::vector<TToken>& statement = lines[append].tokens;
+        if (!isScalar(statement, 4, statement.size() - 4, loop.variable)) continue;
+        
+        // Within the loop, the list is only ever appended to, sized or indexed.
+        std::vector<std::pair<size_t, size_t>> sizes;    // the line and token of each SIZE(list)
+        bool whole = false;
+        for (size_t n = i + 1; n < loop.end && !whole; ++n) {
+            const std::vector<TToken>& tokens = lines[n].tokens;
+            for (size_t k = 0; k < tokens.size(); ++k) {
+                if (!isIdentifier(tokens[k]) || tokens[k].text != list) continue;
+                if (n == append && (k == 2 || k == tokens.size() - 2)) continue;
+                
+                if (k >= 2 && k + 1 < tokens.size() && isSymbol(tokens[k - 1], "(") && isSymbol(tokens[k + 1], ")")
+                    && (isWord(tokens[k - 2], "SIZE") || isWord(tokens[k - 2], "length"))) {
+                    sizes.push_back({n, k - 2});
+                    continue;
+                }
+                if (k + 1 < tokens.size() && (isSymbol(tokens[k + 1], "[") || isSymbol(tokens[k + 1], "("))) {
+                    size_t close = matchingBracket(tokens, k + 1);
+                    if (close + 1 >= tokens.size() || !isSymbol(tokens[close + 1], ":=")) continue;
+                }
+                whole = true;
+                break;
+            }
+        }
+        if (whole) continue;
+        
+        std::string size = uniqueName(function, std::string(list) + "_size");
+        std::string_view name = hold(size);
+        std::string_view indent = lines[i].tokens[0].space;
+        
+        std::string value;
+        for (size_t k = 4; k < statement.size() - 4; ++k) {
+            if (k > 4) value += statement[k].space;
+            value += statement[k].text;
+        }
+        TLine store = makeLine(hold(std::string(statement[0].space) + size + " := " + size + " + 1; " + std::string(list) + "[" + size + "] := " + value + ";"));
+        lines[append] = std::move(store);
+        
+        for (auto it = sizes.rbegin(); it != sizes.rend(); ++it) {
+            std::vector<TReplacement> replacements = {{it->second, it->second + 4, {makeToken(TToken::Type::Name, name)}}};
+            replaceTokens(lines[it->first], replacements);
+        }
+        
+        std::vector<TLine> allocation = {
+            makeLine(hold(std::string(indent) + "LOCAL " + size + " := SIZE(" + std::string(list) + ");")),
+            makeLine(hold(std::string(indent) + "CONCAT(" + std::string(list) + ", MAKELIST(0,1," + std::to_string(count) + ")) ▶ " + std::string(list) + ";"))
+        };
+        lines.insert(lines.begin() + i, allocation.begin(), allocation.end());
+        i += allocation.size();
+        
+        // The lines of every variable after these have moved.
+        variables.clear();
+        preallocated++;
+    }
+    
+    return preallocated;
+}
+
+// MARK: - Loop Invariants
+
+typedef struct TInvariants {
+    const TFunction *function;
+    const std::unordered_map<std::string_view, TVariable> *variables;
+    size_t begin;               // the lines of the loop, from its first up to its END, or UNTIL
+    size_t end;
+} TInvariants;
+
+/*
+ True if the expression evaluates to the same value every time within the loop, only naming the
+ function's own variables that the loop never assigns to, and calling nothing but the built-ins
+ that only ever return a value of their arguments.
+ */
+static bool isLoopInvariant(const TExpressionParser& parser, const TExpression& node, const TInvariants& loop) {
+    const std::vector<TToken>& tokens = *parser.tokens;
+    
+    if (node.kind == TExpression::Kind::Opaque) {
+        const TToken& token = tokens[node.first];
+        if (!isIdentifier(token)) return true;
+        if ((node.first > 0 && isSymbol(tokens[node.first - 1], "::")) || (node.last < tokens.size() && isSymbol(tokens[node.last], "::"))) return false;
+        
+        auto it = loop.variables->find(token.text);
+        return it != loop.variables->end() && isOwn(*loop.function, it->second, token.text) && !isAssigned(it->second, loop.begin, loop.end);
+    }
+    
+    if (node.kind == TExpression::Kind::Call && (node.op == "[]" || !isPure(node.op))) return false;
+    
+    for (int n = 0; n < node.count; ++n) {
+        if (!isLoopInvariant(parser, parser.nodes[children(parser, node)[n]], loop)) return false;
+    }
+    return true;
+}
+
+/*
+ True if evaluating the expression can never fail, as it's evaluated before the loop even should
+ the loop never get as far as evaluating it, such as by never looping at all. A division, or
+ power, is only ever by a constant that can't fail it.
+ */
+static bool isTotal(const TExpressionParser& parser, const TExpression& node) {
+    if (node.kind == TExpression::Kind::Binary && (node.op == "/" || node.op == "MOD" || node.op == "^")) {
+        const TExpression& operand = parser.nodes[children(parser, node)[1]];
+        double d;
+        if (!operand.constant || !real(operand.value, d) || d <= 0 || (node.op == "^" && d != std::floor(d))) return false;
+    }
+    
+    for (int n = 0; n < node.count; ++n) {
+        if (!isTotal(parser, parser.nodes[children(parser, node)[n]])) return false;
+    }
+    return true;
+}
+
+// Gathers the largest expressions of the loop's that are worth evaluating the once, before it.
+static void gatherInvariants(const TExpressionParser& parser, int index, const TInvariants& loop, std::vector<std::pair<size_t, size_t>>& invariants) {
+    const TExpression& node = parser.nodes[index];
+    const TExpression *inner = &node;
+    while (inner->kind == TExpression::Kind::Group) inner = &parser.nodes[*children(parser, *inner)];
+    
+    bool worth = inner->kind == TExpression::Kind::Binary || (inner->kind == TExpression::Kind::Call && inner->op != "{" && inner->op != "[");
+    if (worth && !node.constant && isLoopInvariant(parser, node, loop) && isTotal(parser, node)) {
+        invariants.push_back({node.first, node.last});
+        return;
+    }
+    
+    for (int n = 0; n < node.count; ++n) {
+        gatherInvariants(parser, children(parser, node)[n], loop, invariants);
+    }
+}
+
+// The first line and the END, or UNTIL, line of a loop starting on line `index`.
+static bool isLoop(const TFunction& function, size_t index, size_t& first, size_t& end) {
+    const std::vector<TToken>& tokens = function.lines[index].tokens;
+    if (tokens.empty()) return false;
+    
+    first = 0;
+    if (isLine(function.lines[index], {"REPEAT"})) {
+        first = 1;
+    }
+    else if (isWord(tokens.back(), "DO")) {
+        if (isWord(tokens[0], "FOR")) {
+            first = tokens.size();
+        }
+        else {
+            for (size_t k = 0; k < tokens.size(); ++k) {
+                if (opens(tokens[k])) {
+                    first = isWord(tokens[k], "WHILE") ? k + 1 : 0;
+                    break;
+                }
+            }
+        }
+    }
+    if (!first) return false;
+    
+    end = endOfBlock(function, index, nullptr);
+    return end < function.lines.size();
+}
+
+/*
+ Moves each expression within a loop that's evaluated to the same value every time, other than
+ those of the range of a FOR, which is only ever evaluated the once, into a LOCAL before the
+ loop, eg. RGB(255, 0, 0) or (320 - w) / 2, the loop then using the LOCAL in its place. Loops
+ are looked into from the outermost in, so each expression is moved as far out as it can be.
+ */
+static long hoistInvariants(TFunction& function, TExpressionParser& parser) {
+    std::vector<TLine>& lines = function.lines;
+    TRegions regions;
+    std::unordered_map<std::string_view, TVariable> variables = findVariables(function, regions);
+    std::vector<std::pair<size_t, std::vector<TLine>>> insertions;
+    long hoisted = 0;
+    
+    for (size_t i = 0; i < lines.size(); ++i) {
+        size_t first, end;
+        if (!isLoop(function, i, first, end)) continue;
+        
+        TInvariants loop = {&function, &variables, i, end};
+        
+        // The expressions of each line moved, and the LOCAL each is moved to, by their text.
+        std::vector<std::vector<TReplacement>> replacements(end - i + 1);
+        typedef struct TLocal {
+            std::string key;        // the text of the expression, without whitespace
+            std::string name;
+        } TLocal;
+        std::vector<TLocal> locals;
+        std::vector<std::string> names;
+        std::vector<TLine> declarations;
+        
+        for (size_t n = i; n <= end; ++n) {
+            const std::vector<TToken>& tokens = lines[n].tokens;
+            std::vector<std::pair<size_t, size_t>> invariants;
+            
+            forEachExpression(tokens, [&](size_t start, size_t last) {
+                if (n == i && start < first) return;
+                int root = parse(parser, tokens, start, last);
+                if (root >= 0) gatherInvariants(parser, root, loop, invariants);
+            });
+            
+            for (const std::pair<size_t, size_t>& invariant : invariants) {
+                size_t from = invariant.first, to = invariant.second;
+                while (isSymbol(tokens[from], "(") && matchingBracket(tokens, from) == to - 1) from++, to--;
+                
+                std::string text, key;
+                for (size_t k = from; k < to; ++k) {
+                    if (k > from) text += tokens[k].space;
+                    text += tokens[k].text;
+                    key += tokens[k].text;
+                }
+                
+                auto it = std::find_if(locals.begin(), locals.end(), [&key](const TLocal& local) {
+                    return local.key == key;
+                });
+                if (it == locals.end()) {
+                    names.push_back(uniqueName(function, "tmp", names));
+                    std::string_view indent = lines[i].tokens[0].space;
+                    declarations.push_back(makeLine(hold(std::string(indent) + "LOCAL " + names.back() + " := " + text + ";")));
+                    locals.push_back({key, names.back()});
+                    it = locals.end() - 1;
+                }
+                replacements[n - i].push_back({invariant.first, invariant.second, {makeToken(TToken::Type::Name, hold(it->name))}});
+            }
+        }
+        if (declarations.empty()) continue;
+        
+        for (size_t n = i; n <= end; ++n) replaceTokens(lines[n], replacements[n - i]);
+        
+        // Each LOCAL is as good as declared by the loop's first line to the loops within it.
+        for (const TLocal& local : locals) {
+            TVariable& variable = variables[hold(local.name)];
+            variable.declared = variable.local = true;
+            variable.definition = {i, 0, 0};
+        }
+        insertions.push_back({i, std::move(declarations)});
+        hoisted += locals.size();
+    }
+    
+    // The lines are inserted last to first, leaving the lines of any before them where they are.
+    for (auto it = insertions.rbegin(); it != insertions.rend(); ++it) {
+        lines.insert(lines.begin() + it->first, it->second.begin(), it->second.end());
+    }
+    return hoisted;
+}
+
+// MARK: - Compound Assignments
+
+// True if the token ends the statement before it, or opens the block the statement is within.
+static bool startsStatement(const TToken& token) {
+    return isSymbol(token, ";") || isWord(token, "THEN") || isWord(token, "ELSE") || isWord(token, "DO")
+        || isWord(token, "REPEAT") || isWord(token, "BEGIN") || isWord(token, "DEFAULT");
+}
+
+/*
+ A compound assignment of C to an element of a list, or matrix, is translated as the element
+ being assigned its own value with the operator applied, eg. a[(i * w + j) + 1] += v becomes
+ 
+   a[(i * w + j) + 1] := a[(i * w + j) + 1] + v;
+ 
+ evaluating every index twice. Each index of more than a single operation is instead held by
+ a LOCAL, so that it's evaluated the once, as the index of C would be, eg.
+ 
+   LOCAL tmp := (i * w + j) + 1; a[tmp] := a[tmp] + v;
+ 
+ An index may only name the function's own variables, which nothing within the statement could
+ then assign to. It may call any function, as C calls it the once. Any other copy of the element
+ in the statement has its index replaced too, unless the index calls anything other than
+ built-ins returning a value of their arguments, C calling it again for each such copy.
+ */
+static long evaluateIndicesOnce(TFunction& function, TExpressionParser& parser) {
+    TRegions regions;
+    std::unordered_map<std::string_view, TVariable> variables;
+    std::vector<std::string> names;
+    long evaluated = 0;
+    
+    for (TLine& line : function.lines) {
+        const std::vector<TToken>& tokens = line.tokens;
+        std::vector<TReplacement> replacements;
+        int depth = 0;
+        
+        for (size_t p = 0; p + 1 < tokens.size(); ++p) {
+            if (isOpeningBracket(tokens[p])) depth++;
+            if (isClosingBracket(tokens[p])) depth--;
+            if (depth != 0 || !isIdentifier(tokens[p]) || !isSymbol(tokens[p + 1], "[") || (p > 0 && !startsStatement(tokens[p - 1]))) continue;
+            
+            // The element assigned to, then the same element followed by an operator.
+            size_t close = matchingBracket(tokens, p + 1);
+            size_t length = close + 1 - p;
+            size_t value = close + 2;
+            if (close + 1 >= tokens.size() || !isSymbol(tokens[close + 1], ":=") || value + length >= tokens.size()) continue;
+            if (!std::equal(tokens.begin() + p, tokens.begin() + close + 1, tokens.begin() + value, [](const TToken& a, const TToken& b) {
+                return a.text == b.text;
+            })) continue;
+            const TToken& op = tokens[value + length];
+            if (op.precedence == None && !isWord(op, "MOD")) continue;
+            
+            // Any other copy of the element up to the end of the statement.
+            std::vector<size_t> copies;
+            size_t end = value + length;
+            for (int inner = 0; end < tokens.size(); ++end) {
+                if (isOpeningBracket(tokens[end])) inner++;
+                if (isClosingBracket(tokens[end])) inner--;
+                if (inner < 0 || (inner == 0 && isSymbol(tokens[end], ";"))) break;
+                
+                if (tokens[end].text != tokens[p].text || !isIdentifier(tokens[end]) || end + length > tokens.size()) continue;
+                if (isSymbol(tokens[end - 1], "::")) continue;
+                if (std::equal(tokens.begin() + p, tokens.begin() + close + 1, tokens.begin() + end, [](const TToken& a, const TToken& b) {
+                    return a.text == b.text;
+                })) {
+                    copies.push_back(end);
+                    end += length - 1;
+                }
+            }
+            
+            // Each index of the element, as the tokens from first up to last.
+            std::vector<std::pair<size_t, size_t>> indices;
+            for (size_t k = p + 2, first = k, inner = 0; k <= close; ++k) {
+                if (k == close || (inner == 0 && isSymbol(tokens[k], ","))) {
+                    indices.push_back({first, k});
+                    first = k + 1;
+                    continue;
+                }
+                if (isOpeningBracket(tokens[k])) inner++;
+                if (isClosingBracket(tokens[k])) inner--;
+            }
+            
+            if (variables.empty()) variables = findVariables(function, regions);
+            std::vector<TToken> declarations;
+            std::vector<TReplacement> uses;
+            long held = 0;
+            for (const std::pair<size_t, size_t>& index : indices) {
+                // An index such as (i) + 1 costs no more to evaluate twice than to hold.
+                if (parse(parser, tokens, index.first, index.second) < 0) continue;
+                if (std::count_if(parser.nodes.begin(), parser.nodes.end(), [](const TExpression& node) {
+                    return node.kind == TExpression::Kind::Unary || node.kind == TExpression::Kind::Binary || node.kind == TExpression::Kind::Call;
+                }) < 2) continue;
+                
+                bool own = true, pure = true;
+                for (size_t k = index.first; k < index.second; ++k) {
+                    if (isSymbol(tokens[k], "::")) own = false;
+                    if (!isIdentifier(tokens[k])) continue;
+                    if (k + 1 < index.second && isSymbol(tokens[k + 1], "(")) {
+                        pure &= isPure(tokens[k].text);
+                        continue;
+                    }
+                    auto it = variables.find(tokens[k].text);
+                    own &= it != variables.end() && isOwn(function, it->second, tokens[k].text);
+                }
+                if (!own) continue;
+                
+                names.push_back(uniqueName(function, "tmp", names));
+                std::string text;
+                for (size_t k = index.first; k < index.second; ++k) {
+                    if (k > index.first) text += tokens[k].space;
+                    text += tokens[k].text;
+                }
+                TLine declaration = makeLine(hold("LOCAL " + names.back() + " := " + text + ";"));
+                declarations.insert(declarations.end(), declaration.tokens.begin(), declaration.tokens.end());
+                
+                TToken name = makeToken(TToken::Type::Name, hold(names.back()));
+                held++;
+                uses.push_back({index.first, index.second, {name}});
+                uses.push_back({index.first - p + value, index.second - p + value, {name}});
+                if (pure) {
+                    for (size_t copy : copies) uses.push_back({index.first - p + copy, index.second - p + copy, {name}});
+                }
+            }
+            if (declarations.empty()) continue;
+            
+            TToken statement = tokens[p];
+            statement.space = " ";
+            declarations.push_back(statement);
+            replacements.push_back({p, p + 1, declarations});
+            replacements.insert(replacements.end(), uses.begin(), uses.end());
+            evaluated += held;
+            p = end - 1;
+        }
+        
+        replaceTokens(line, replacements);
+    }
+    
+    return evaluated;
+}
+
+// MARK: - Inlining
+
+// The most tokens the expression returned by a function may have for it to be inlined.
+#define INLINE_SIZE 24
+
+typedef struct TInline {
+    std::vector<std::string_view> parameters;
+    std::vector<TToken> body;   // the expression returned
+    std::vector<int> uses;      // how many times the body names each parameter
+    std::vector<bool> indexed;  // whether the body indexes, or calls, each parameter
+    bool grouped = false;       // needs no parentheses of its own, being a call, name or value
+} TInline;
+
+/*
+ True if the function is small enough to be inlined, its body being a single RETURN of an
+ expression that only calls built-ins that only ever return a value of their arguments, eg.
+ 
+   RETURN MIN(MAX(v, lo), hi);
+ 
+ Such a function calls no function of the program, so is never recursive, and has no effect
+ other than its value.
+ */
+static bool isInline(const TFunction& function, TExpressionParser& parser, TInline& inlined) {
+    if (function.lines.size() != 1) return false;
+    
+    const std::vector<TToken>& tokens = function.lines.front().tokens;
+    if (tokens.size() < 3 || tokens.size() > INLINE_SIZE + 2 || !isWord(tokens.front(), "RETURN") || !isSymbol(tokens.back(), ";")) return false;
+    
+    int root = parse(parser, tokens, 1, tokens.size() - 1);
+    if (root < 0) return false;
+    TExpression::Kind kind = parser.nodes[root].kind;
+    
+    inlined.parameters = function.parameters;
+    inlined.uses.assign(function.parameters.size(), 0);
+    inlined.indexed.assign(function.parameters.size(), false);
+    inlined.grouped = kind != TExpression::Kind::Unary && kind != TExpression::Kind::Binary;
+    
+    for (size_t k = 1; k + 1 < tokens.size(); ++k) {
+        if (isSymbol(tokens[k], "::")) return false;
+        if (!isIdentifier(tokens[k])) continue;
+        
+        bool applied = isSymbol(tokens[k + 1], "(") || isSymbol(tokens[k + 1], "[");
+        auto it = std::find(function.parameters.begin(), function.parameters.end(), tokens[k].text);
+        if (it != function.parameters.end()) {
+            inlined.uses[it - function.parameters.begin()]++;
+            if (applied) inlined.indexed[it - function.parameters.begin()] = true;
+            continue;
+        }
+        if (isSymbol(tokens[k + 1], "(") && !isPure(tokens[k].text)) return false;
+    }
+    
+    inlined.body.assign(tokens.begin() + 1, tokens.end() - 1);
+    inlined.body.front().space = "";
+    return true;
+}
+
+// True if the statement starting at the beginning of line `index` doesn't continue one from a line before it.
+static bool startsLine(const TFunction& function, size_t index) {
+    while (index > 0 && function.lines[index - 1].tokens.empty()) index--;
+    if (index == 0) return true;
+    
+    const std::vector<TToken>& tokens = function.lines[index - 1].tokens;
+    size_t last = tokens.size() - 1;
+    if (last > 0 && tokens[last].type == TToken::Type::Comment) last--;
+    return startsStatement(tokens[last]);
+}
+
+/*
+ Replaces the call at token `k` of line `l` with the body of the function called, each of its
+ parameters in turn replaced by the argument given for it. An argument that is a single name
+ or value, a constant, or one the body uses only the once, is put in place of its parameter.
+ Any other is held by a fresh LOCAL, named after the parameter, declared before the statement,
+ so that it's still evaluated the once, eg. t := t + Square(i + 1) becomes
+ 
+   LOCAL x := i + 1; t := t + (x * x);
+ 
+ Arguments are evaluated before the body, so at most one argument may call anything other than
+ a built-in returning a value of its arguments, with the others only ever naming values the
+ call couldn't change.
+ */
+static bool inlineCall(TFunction& function, size_t l, size_t k, size_t statement, const TInline& inlined,
+                       std::unordered_set<std::string_view>& own, TExpressionParser& parser) {
+    TLine& line = function.lines[l];
+    const std::vector<TToken>& tokens = line.tokens;
+    
+    size_t close = matchingBracket(tokens, k + 1);
+    if (close >= tokens.size() || statement == k) return false;
+    
+    // Each argument, as the tokens from first up to last.
+    std::vector<std::pair<size_t, size_t>> arguments;
+    if (close > k + 2) {
+        for (size_t i = k + 2, first = i, depth = 0; i <= close; ++i) {
+            if (i == close || (depth == 0 && isSymbol(tokens[i], ","))) {
+                arguments.push_back({first, i});
+                first = i + 1;
+                continue;
+            }
+            if (isOpeningBracket(tokens[i])) depth++;
+            if (isClosingBracket(tokens[i])) depth--;
+        }
+    }
+    if (arguments.size() != inlined.parameters.size()) return false;
+    
+    // Any name of the body, other than a parameter, must still name the same where inlined.
+    std::vector<std::string> taken;
+    for (const TToken& token : inlined.body) {
+        if (!isIdentifier(token) || std::find(inlined.parameters.begin(), inlined.parameters.end(), token.text) != inlined.parameters.end()) continue;
+        if (own.count(token.text)) return false;
+        taken.push_back(std::string(token.text));
+    }
+    
+    bool declarable = isIdentifier(tokens[statement]) || isWord(tokens[statement], "RETURN");
+    if (statement == 0) declarable &= startsLine(function, l);
+    for (const TToken& token : tokens) {
+        if (assignsArguments(token)) declarable = false;
+    }
+    
+    std::vector<std::vector<TToken>> substitutes(arguments.size());
+    std::vector<TToken> declarations;
+    size_t impure = 0;          // the arguments calling more than built-ins returning a value of theirs
+    bool fixed = true;          // every other argument only names values such a call couldn't change
+    
+    for (size_t n = 0; n < arguments.size(); ++n) {
+        size_t first = arguments[n].first, last = arguments[n].second;
+        
+        bool pure = true, owned = true;
+        for (size_t i = first; i < last; ++i) {
+            if (isKeyword(tokens[i]) || assignsArguments(tokens[i])) return false;
+            if (isSymbol(tokens[i], "::")) pure = false;
+            if (!isIdentifier(tokens[i])) continue;
+            if (i + 1 < last && isSymbol(tokens[i + 1], "(")) pure &= isPure(tokens[i].text);
+            else owned &= own.count(tokens[i].text) > 0;
+        }
+        
+        int root = parse(parser, tokens, first, last);
+        if (root < 0) return false;
+        bool constant = parser.nodes[root].constant;
+        bool grouped = parser.nodes[root].kind != TExpression::Kind::Unary && parser.nodes[root].kind != TExpression::Kind::Binary;
+        
+        if (!pure) impure++;
+        else if (!owned) fixed = false;
+        
+        if (inlined.uses[n] == 0) {
+            if (!pure) return false;
+            continue;
+        }
+        
+        std::vector<TToken>& substitute = substitutes[n];
+        if (last - first == 1 || constant || (inlined.uses[n] == 1 && !inlined.indexed[n])) {
+            if (!grouped) substitute.push_back(makeToken(TToken::Type::Symbol, "("));
+            substitute.insert(substitute.end(), tokens.begin() + first, tokens.begin() + last);
+            if (!grouped) {
+                substitute[1].space = "";
+                substitute.push_back(makeToken(TToken::Type::Symbol, ")"));
+            }
+            continue;
+        }
+        
+        if (!declarable || !pure || !owned) return false;
+        
+        std::string name = uniqueName(function, inlined.parameters[n], taken);
+        taken.push_back(name);
+        std::string text;
+        for (size_t i = first; i < last; ++i) {
+            if (i > first) text += tokens[i].space;
+            text += tokens[i].text;
+        }
+        TLine declaration = makeLine(hold("LOCAL " + name + " := " + text + ";"));
+        declarations.insert(declarations.end(), declaration.tokens.begin(), declaration.tokens.end());
+        substitute.push_back(makeToken(TToken::Type::Name, hold(name)));
+    }
+    
+    if (impure > 1 || (impure == 1 && !fixed)) return false;
+    
+    std::vector<TToken> expression;
+    if (!inlined.grouped) expression.push_back(makeToken(TToken::Type::Symbol, "("));
+    for (const TToken& token : inlined.body) {
+        auto it = std::find(inlined.parameters.begin(), inlined.parameters.end(), token.text);
+        if (!isIdentifier(token) || it == inlined.parameters.end()) {
+            expression.push_back(token);
+            continue;
+        }
+        const std::vector<TToken>& substitute = substitutes[it - inlined.parameters.begin()];
+        expression.insert(expression.end(), substitute.begin(), substitute.end());
+        expression[expression.size() - substitute.size()].space = token.space;
+    }
+    if (!inlined.grouped) expression.push_back(makeToken(TToken::Type::Symbol, ")"));
+    
+    std::vector<TReplacement> replacements = {{k, close + 1, expression}};
+    if (!declarations.empty()) {
+        TToken first = tokens[statement];
+        first.space = " ";
+        declarations.push_back(first);
+        replacements.push_back({statement, statement + 1, declarations});
+    }
+    replaceTokens(line, replacements);
+    
+    for (const std::vector<TToken>& substitute : substitutes) {
+        if (substitute.size() == 1 && substitute.front().type == TToken::Type::Name) own.insert(substitute.front().text);
+    }
+    return true;
+}
+
+/*
+ Inlines every call of the function to functions of the program small enough to be, eg. a call
+ to Square(x), whose body is RETURN x * x;, put in place of Square(n) becomes (n * n).
+ */
+static long inlineCalls(TFunction& function, const std::unordered_map<std::string_view, TInline>& inlines, TExpressionParser& parser) {
+    if (inlines.empty()) return 0;
+    
+    // Any code evaluated from a string at runtime could name any of the function's variables.
+    for (const TLine& line : function.lines) {
+        for (const TToken& token : line.tokens) {
+            if (isWord(token, "EXPR")) return 0;
+        }
+    }
+    
+    TRegions regions;
+    std::unordered_set<std::string_view> own(function.parameters.begin(), function.parameters.end());
+    for (const auto& it : findVariables(function, regions)) {
+        if (it.second.local) own.insert(it.first);
+    }
+    
+    long inlined = 0;
+    for (size_t l = 0; l < function.lines.size(); ++l) {
+        // The line is looked at afresh after each call inlined, as its tokens have changed.
+        for (bool changed = true; changed;) {
+            const std::vector<TToken>& tokens = function.lines[l].tokens;
+            size_t statement = 0;
+            int depth = 0;
+            changed = false;
+            
+            for (size_t k = 0; k + 1 < tokens.size(); ++k) {
+                if (isOpeningBracket(tokens[k])) depth++;
+                if (isClosingBracket(tokens[k])) depth--;
+                if (depth == 0 && startsStatement(tokens[k])) statement = k + 1;
+                
+                if (!isIdentifier(tokens[k]) || !isSymbol(tokens[k + 1], "(") || own.count(tokens[k].text)) continue;
+                if (k > 0 && isSymbol(tokens[k - 1], "::")) continue;
+                
+                auto it = inlines.find(tokens[k].text);
+                if (it != inlines.end() && inlineCall(function, l, k, statement, it->second, own, parser)) {
+                    inlined++;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+    
+    return inlined;
+}
+
+// MARK: -
+
+static void optimizeFunction(TFunction& function, TExpressionParser& parser, Optimizer::TStatistics& statistics) {
+    if (!isStructured(function)) return;
+    
+    // Any code evaluated from a string at runtime could assign to any variable.
+    for (const TLine& line : function.lines) {
+        for (const TToken& token : line.tokens) {
+            if (isWord(token, "EXPR")) return;
+        }
+    }
+    
+    // Each pass may uncover more for the others to do, so they're repeated for as long as they do.
+    for (int pass = 0; pass < 16; ++pass) {
+        for (TLine& line : function.lines) {
+            if (line.dirty) statistics.folded += foldLine(line, parser);
+        }
+        
+        bool changed = propagateConstants(function, parser, statistics);
+        changed |= removeBranches(function, parser, statistics);
+        if (!changed) break;
+    }
+    
+    statistics.loops += makeForLoops(function, parser);
+    statistics.offsets += removeIndexOffsets(function, parser);
+    statistics.preallocated += preallocateLists(function, parser);
+    statistics.hoisted += hoistInvariants(function, parser);
+    statistics.indices += evaluateIndicesOnce(function, parser);
+}
+
+// A function's header, eg. `EXPORT name(a, b)`, followed by its BEGIN on a line of its own.
+static bool isFunctionHeader(std::string_view header, std::string_view begin, std::string_view& name, std::vector<std::string_view>& parameters) {
+    if (begin != "BEGIN") return false;
+    
+    TLine line = makeLine(header);
+    const std::vector<TToken>& tokens = line.tokens;
+    size_t i = !tokens.empty() && isWord(tokens.front(), "EXPORT") ? 1 : 0;
+    
+    if (i + 2 >= tokens.size() || !isIdentifier(tokens[i]) || !isSymbol(tokens[i + 1], "(") || !isSymbol(tokens.back(), ")")) return false;
+    
+    name = tokens[i].text;
+    parameters.clear();
+    for (i += 2; i + 1 < tokens.size(); i += 2) {
+        if (!isIdentifier(tokens[i])) return false;
+        parameters.push_back(tokens[i].text);
+        if (!isSymbol(tokens[i + 1], ",") && i + 2 < tokens.size()) return false;
+    }
+    return true;
+}
+
+void Optimizer::optimize(std::string& ppl) {
+    std::vector<std::string_view> lines;
+    
+    _strings.clear();
+    for (size_t pos = 0; pos < ppl.length();) {
+        size_t end = ppl.find('\n', pos);
+        if (end == std::string::npos) end = ppl.length();
+        lines.push_back(std::string_view(ppl).substr(pos, end - pos));
+        pos = end + 1;
+    }
+    
+    // Every function, from the line of its header up to that of its END;, is found before any is optimized, so any may be inlined.
+    typedef struct TDefinition {
+        size_t header;
+        size_t end;
+        std::string_view name;
+        std::vector<std::string_view> parameters;
+    } TDefinition;
+    std::vector<TDefinition> definitions;
+    
+    for (size_t i = 0; i < lines.size(); ++i) {
+        // Python is left just as it is.
+        if (lines[i].compare(0, 7, "#PYTHON") == 0) {
+            while (i < lines.size() && lines[i].compare(0, 4, "#END") != 0) i++;
+            continue;
+        }
+        
+        TDefinition definition = {i};
+        if (i + 1 < lines.size() && isFunctionHeader(lines[i], lines[i + 1], definition.name, definition.parameters)) {
+            size_t end = i + 2;
+            while (end < lines.size() && lines[end] != "END;") end++;
+            
+            if (end < lines.size()) {
+                definition.end = end;
+                definitions.push_back(std::move(definition));
+                i = end;
+            }
+        }
+    }
+    
+    TExpressionParser parser;
+    TFunction function;
+    std::unordered_map<std::string_view, TInline> inlines;
+    if (inlining) {
+        // A name given to more than one function can't be known to call either.
+        std::unordered_map<std::string_view, int> names;
+        for (const TDefinition& definition : definitions) names[definition.name]++;
+        
+        for (const TDefinition& definition : definitions) {
+            if (definition.end != definition.header + 3 || names[definition.name] != 1) continue;
+            
+            function.name = definition.name;
+            function.parameters = definition.parameters;
+            function.lines = {makeLine(lines[definition.header + 2])};
+            
+            TInline inlined;
+            if (isInline(function, parser, inlined)) inlines[definition.name] = std::move(inlined);
+        }
+        
+        // Nor can a function be inlined should it call one of the program's own, named as a built-in.
+        for (auto it = inlines.begin(); it != inlines.end();) {
+            const std::vector<TToken>& body = it->second.body;
+            bool calls = false;
+            for (size_t k = 0; k + 1 < body.size(); ++k) {
+                if (isIdentifier(body[k]) && isSymbol(body[k + 1], "(") && names.count(body[k].text)) calls = true;
+            }
+            it = calls ? inlines.erase(it) : std::next(it);
+        }
+    }
+    
+    std::string optimized;
+    optimized.reserve(ppl.size());
+    
+    auto definition = definitions.begin();
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (definition != definitions.end() && definition->header == i) {
+            function.name = definition->name;
+            function.parameters = definition->parameters;
+            function.lines.clear();
+            for (size_t n = i + 2; n < definition->end; ++n) function.lines.push_back(makeLine(lines[n]));
+            
+            _statistics.inlined += inlineCalls(function, inlines, parser);
+            optimizeFunction(function, parser, _statistics);
+            
+            for (size_t n = i; n < i + 2; ++n) {
+                optimized += lines[n];
+                optimized += '\n';
+            }
+            for (TLine& line : function.lines) {
+                if (line.changed) render(line);
+                optimized += line.text;
+                optimized += '\n';
+            }
+            optimized += lines[definition->end];
+            optimized += '\n';
+            i = definition->end;
+            definition++;
+            continue;
+        }
+        
+        optimized += lines[i];
+        optimized += '\n';
+    }
+    
+    // The text is only ever given a newline at the end should it have had one.
+    if (!ppl.empty() && ppl.back() != '\n') optimized.pop_back();
+    ppl = std::move(optimized);
+    _strings.clear();
+}
+
+void Optimizer::printStatistics(std::ostream& os) const {
+    os << "Optimizer: "
+       << _statistics.propagated << " uses of constants replaced, "
+       << _statistics.folded << " expressions folded, "
+       << _statistics.branches << " branches removed, "
+       << _statistics.loops << " loops made FOR loops, "
+       << _statistics.offsets << " indices no longer offset, "
+       << _statistics.preallocated << " lists preallocated, "
+       << _statistics.hoisted << " loop invariants hoisted, "
+       << _statistics.indices << " indices evaluated once, "
+       << _statistics.inlined << " calls inlined\n";
+}
@@ -0,0 +1,69 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+#include <iostream>
+#include <string>
+
+namespace pp {
+    /*
+     Optimizes the PPL of a program once it has been translated in full, a function at a time,
+     as it is only then that all of a function's body is known.
+     
+     Each line of a function is split into tokens, each keeping the whitespace before it, so a
+     line is written out exactly as it was translated unless one of the passes changed it.
+     */
+    class Optimizer {
+    public:
+        typedef struct TStatistics {
+            long propagated = 0;    // uses of a constant replaced by its value
+            long folded = 0;        // constant expressions replaced by their value
+            long branches = 0;      // branches removed, their condition being constant
+            long loops = 0;         // WHILE loops counting a variable through a range made FOR loops
+            long offsets = 0;       // indices by a loop's variable no longer offset by one
+            long preallocated = 0;  // lists appended to by a loop extended the once beforehand
+            long hoisted = 0;       // expressions of a loop evaluated the once before it
+            long indices = 0;       // indices of a compound assignment evaluated the once
+            long inlined = 0;       // calls to small functions replaced by the function's body
+        } TStatistics;
+        
+        // Calls to small functions of the program are inlined, as asked for by #pragma ( inline )
+        bool inlining = false;
+        
+        void optimize(std::string& ppl);
+        
+        const TStatistics& statistics(void) const {
+            return _statistics;
+        }
+        
+        void printStatistics(std::ostream& os) const;
+        
+    private:
+        TStatistics _statistics;
+    };
+}
+
+#endif /* OPTIMIZER_HPP */
@@ -0,0 +1,327 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#include "patterns.hpp"
+
+#include <vector>
+#include <iomanip>
+
+using namespace pp;
+
+static std::vector<const Pattern *>& registry(void) {
+    static std::vector<const Pattern *> patterns;
+    return patterns;
+}
+
+// MARK: - Match
+
+Match::TGroup Match::operator[](size_t n) const {
+    TGroup group;
+    if (n >= _size || !_captures[n * 2]) {
+        group.first = group.second = _last;
+        return group;
+    }
+    group.first = _captures[n * 2];
+    group.second = _captures[n * 2 + 1];
+    group.matched = true;
+    return group;
+}
+
+size_t Match::position(size_t n) const {
+    return (*this)[n].first - _begin;
+}
+
+// MARK: - Iterators
+
+/*
+ Searches on from the end of the current match. An empty match is followed by a search for a
+ non-empty match at the same position before moving on by one, as std::regex_iterator does.
+ */
+MatchIterator& MatchIterator::operator++() {
+    const char *start = _match._captures[1];
+    
+    if (_match._captures[0] == start) {
+        if (start == _match._last) {
+            _pattern = nullptr;
+            return *this;
+        }
+        if (_pattern->find(_match._begin, start, _match._last, _match, regex::Anchored | regex::NotNull)) return *this;
+        start++;
+    }
+    
+    if (!_pattern->find(_match._begin, start, _match._last, _match, regex::Search)) _pattern = nullptr;
+    return *this;
+}
+
+bool MatchIterator::operator==(const MatchIterator& other) const {
+    if (!_pattern || !other._pattern) return _pattern == other._pattern;
+    return _pattern == other._pattern && _match._captures[0] == other._match._captures[0] && _match._captures[1] == other._match._captures[1];
+}
+
+TokenIterator& TokenIterator::operator++() {
+    if (++_n < _count) return *this;
+    _n = 0;
+    ++_it;
+    return *this;
+}
+
+TokenIterator TokenIterator::operator++(int) {
+    TokenIterator it = *this;
+    ++*this;
+    return it;
+}
+
+// MARK: - Pattern
+
+Pattern::Pattern(const std::string& name, const char *expression, bool caseless, TSearch search, int groups) : name(name), expression(expression), caseless(caseless), _search(search), _groups(groups) {
+    registry().push_back(this);
+}
+
+const std::vector<const Pattern *>& Pattern::all(void) {
+    return registry();
+}
+
+bool Pattern::find(const char *begin, const char *first, const char *last, Match& match, unsigned mode) const {
+    match._begin = begin;
+    match._last = last;
+    match._size = _groups;
+    return _search(begin, first, last, match._captures, mode);
+}
+
+bool Pattern::count(bool matched) const {
+    _runs.fetch_add(1, std::memory_order_relaxed);
+    if (matched) _matches.fetch_add(1, std::memory_order_relaxed);
+    return matched;
+}
+
+bool Pattern::search(const std::string& str) const {
+    Match match;
+    return search(str, match);
+}
+
+bool Pattern::search(const std::string& str, Match& match) const {
+    return count(find(str.data(), str.data(), str.data() + str.size(), match, regex::Search));
+}
+
+bool Pattern::search(std::string_view str) const {
+    Match match;
+    return count(find(str.data(), str.data(), str.data() + str.size(), match, regex::Search));
+}
+
+bool Pattern::match(const std::string& str) const {
+    Match match;
+    return this->match(str, match);
+}
+
+bool Pattern::match(const std::string& str, Match& match) const {
+    return count(find(str.data(), str.data(), str.data() + str.size(), match, regex::Anchored | regex::Full));
+}
+
+/*
+ Replaces every match, expanding $& and $0 to $99 to the groups of the match, $` and $' to the
+ text before and after it and $$ to $, following std::regex_replace's ECMAScript rules.
+ */
+std::string Pattern::replace(const std::string& str, const std::string& format) const {
+    MatchIterator it = iterator(str);
+    if (it == MatchIterator()) return str;
+    
+    std::string result;
+    result.reserve(str.size() + format.size());
+    const char *copied = str.data();
+    
+    for (; it != MatchIterator(); ++it) {
+        const Match& match = *it;
+        const char *first = match._captures[0];
+        
+        result.append(copied, first - copied);
+        
+        for (size_t i = 0; i < format.size(); ++i) {
+            char c = format[i];
+            if (c != '$' || i + 1 == format.size()) {
+                result.push_back(c);
+                continue;
+            }
+            
+            c = format[++i];
+            if (c == '$') {
+                result.push_back('$');
+            } else if (c == '&') {
+                result.append(first, match._captures[1]);
+            } else if (c == '`') {
+                result.append(copied, first);
+            } else if (c == '\'') {
+                result.append(match._captures[1], match._last);
+            } else if (c >= '0' && c <= '9') {
+                size_t n = c - '0';
+                if (i + 1 < format.size() && format[i + 1] >= '0' && format[i + 1] <= '9') n = n * 10 + format[++i] - '0';
+                if (n < match.size()) result.append(match.str(n));
+            } else {
+                result.push_back('$');
+                i--;
+            }
+        }
+        
+        copied = match._captures[1];
+    }
+    
+    result.append(copied, str.data() + str.size() - copied);
+    return result;
+}
+
+MatchIterator Pattern::iterator(const std::string& str) const {
+    MatchIterator it;
+    if (find(str.data(), str.data(), str.data() + str.size(), it._match, regex::Search)) it._pattern = this;
+    count(it._pattern != nullptr);
+    return it;
+}
+
+TokenIterator Pattern::tokenIterator(const std::string& str, std::initializer_list<int> submatches) const {
+    TokenIterator it;
+    it._it = iterator(str);
+    for (int n : submatches) {
+        if (it._count < regex::MaxGroups) it._submatches[it._count++] = n;
+    }
+    return it;
+}
+
+void Pattern::dumpStatistics(std::ostream& os) {
+    uint64_t runs = 0, matches = 0;
+    
+    os << std::left << std::setw(28) << "pattern" << std::right
+       << std::setw(12) << "runs" << std::setw(12) << "matched" << "\n";
+    
+    for (const Pattern *pattern : registry()) {
+        if (!pattern->runs()) continue;
+        os << std::left << std::setw(28) << pattern->name << std::right
+           << std::setw(12) << pattern->runs() << std::setw(12) << pattern->matches() << "\n";
+    }
+    
+    for (const Pattern *pattern : registry()) {
+        runs += pattern->runs();
+        matches += pattern->matches();
+    }
+    os << std::left << std::setw(28) << "total" << std::right
+       << std::setw(12) << runs << std::setw(12) << matches << "\n";
+}
+
+// MARK: - Shared
+
+const Pattern Patterns::CommaSeparated("CommaSeparated", regex::compile<R"([^,]+(?=[^,]*))">);
+const Pattern Patterns::String("String", regex::compile<R"("[^"]*")">);
+const Pattern Patterns::ClosingBraceOnly("ClosingBraceOnly", regex::compile<R"(^ *\} *$)">);
+
+// MARK: - Prime-C To PPL Translater
+
+// Operators: {}[]()≤≥≠<>=*/+-▶.,;:!^
+const Pattern Patterns::WhitespaceAroundOperators("WhitespaceAroundOperators", regex::compile<R"(\s*([{}[\]()≤≥≠<>=*\/+\-▶.,;:!^&|%])\s*)">);
+const Pattern Patterns::CompoundAssignment("CompoundAssignment", regex::compile<R"(([A-Za-z]\w* *(?:\[.*\] *)*)([*\/+\-&|^%]|(?:>>|<<))=)">);
+const Pattern Patterns::Modulo("Modulo", regex::compile<R"(%)">);
+const Pattern Patterns::TemplateSyntax("TemplateSyntax", regex::compile<R"(< *LOCAL *>)">);
+const Pattern Patterns::TypeCastingSyntax("TypeCastingSyntax", regex::compile<R"(\( *LOCAL *\))">);
+const Pattern Patterns::AssignedExpression("AssignedExpression", regex::compile<R"(\b(?:(?:LOCAL|CONST) +)?[A-Za-z]\w* *:= *(.+);)">);
+const Pattern Patterns::AssignedArithmetic("AssignedArithmetic", regex::compile<R"(\b[A-Za-z]\w* *:= *[A-Za-z]\w* *[\-\+\*\/] *([\d \+\-\*\/\(\)]*);)">);
+const Pattern Patterns::FunctionArguments("FunctionArguments", regex::compile<R"(\b[A-Za-z]\w* *\((.+)\))">);
+const Pattern Patterns::PragmaMode("PragmaMode", regex::compile<R"(\#pragma mode *\(.*\)$)">);
+const Pattern Patterns::ListDeclaration("ListDeclaration", regex::compile<R"(\bLOCAL<LOCAL> ([A-Za-z]\w*)\((\d+)\))">);
+const Pattern Patterns::ConstLocal("ConstLocal", regex::compile<R"(\bCONST +LOCAL\b)">);
+const Pattern Patterns::Sleep("Sleep", regex::compile<R"(\bSLEEP *;)">);
+const Pattern Patterns::Subscript("Subscript", regex::compile<R"(\[([^\[\]]+)\])">);
+const Pattern Patterns::LiteralSubscript("LiteralSubscript", regex::compile<R"(\[(\((\d+)\) *\+ *1)\])">);
+const Pattern Patterns::AdjacentSubscripts("AdjacentSubscripts", regex::compile<R"(\]\[)">);
+const Pattern Patterns::LocalArrayDeclaration("LocalArrayDeclaration", regex::compile<R"((LOCAL [A-Za-z]\w*)\[.*\]( *= *.*))">);
+const Pattern Patterns::ElseLine("ElseLine", regex::compile<R"(^ *\} *ELSE *\{ *$)">);
+const Pattern Patterns::OpeningBraceLine("OpeningBraceLine", regex::compile<R"(^\{ *$)">);
+const Pattern Patterns::ClosingBraceLine("ClosingBraceLine", regex::compile<R"(^\} *$)">);
+const Pattern Patterns::ScopeOpening("ScopeOpening", regex::compile<R"((?:(?:\)|REPEAT|CASE|DO) *\{|^ *BEGIN) *$)">);
+const Pattern Patterns::ScopeClosing("ScopeClosing", regex::compile<R"(^ *(?:\}|END|\} *(?:UNTIL|WHILE) *\(.+\);) *$)">);
+const Pattern Patterns::LoopCondition("LoopCondition", regex::compile<R"(^ *\} *(UNTIL|WHILE) *\((.+)\); *$)">);
+const Pattern Patterns::Assignment("Assignment", regex::compile<R"(([^:=]|^)(?:=)(?!=))">);
+const Pattern Patterns::KeyName("KeyName", regex::compile<R"(^ *(KS?A?_[A-Z\d][a-z]*) *$)">);
+const Pattern Patterns::ExportOrLocal("ExportOrLocal", regex::compile<R"(\b(export|LOCAL)\b +)">);
+const Pattern Patterns::Main("Main", regex::compile<R"(^main\b)">);
+const Pattern Patterns::ForStatement("ForStatement", regex::compile<R"(\bFOR\b *\((.*);(.*);(.*)\) *\{)">);
+const Pattern Patterns::IfStatement("IfStatement", regex::compile<R"(\bIF\b *\((.*)\) *\{)">);
+const Pattern Patterns::WhileStatement("WhileStatement", regex::compile<R"(\bWHILE\b *\((.*)\) *\{)">);
+const Pattern Patterns::RepeatStatement("RepeatStatement", regex::compile<R"(\b(?:REPEAT|DO)\b *\{)">);
+const Pattern Patterns::SpacedAssignment("SpacedAssignment", regex::compile<R"( *:= *)">);
+const Pattern Patterns::PushBack("PushBack", regex::compile<R"(\b([A-Za-z]\w*)\.push_back\((.*)\))">);
+const Pattern Patterns::Front("Front", regex::compile<R"(\b([A-Za-z]\w*)\.front\(\))">);
+const Pattern Patterns::Back("Back", regex::compile<R"(\b([A-Za-z]\w*)\.back\(\))">);
+const Pattern Patterns::Length("Length", regex::compile<R"(\b([A-Za-z]\w*)\.length\(\))">);
+const Pattern Patterns::At("At", regex::compile<R"(\b([A-Za-z]\w*)\.at\((\d+)\))">);
+
+// MARK: - PPL Formatting
+
+const Pattern Patterns::Comma("Comma", regex::compile<R"(,)">);
+const Pattern Patterns::OpeningBrace("OpeningBrace", regex::compile<R"(\{)">);
+const Pattern Patterns::ClosingBrace("ClosingBrace", regex::compile<R"(\})">);
+const Pattern Patterns::ClosingBraceStatement("ClosingBraceStatement", regex::compile<R"(^ +(\} *;))">);
+const Pattern Patterns::EmptyBraces("EmptyBraces", regex::compile<R"(\{ +\})">);
+const Pattern Patterns::DoubleEquals("DoubleEquals", regex::compile<R"(==)">);
+const Pattern Patterns::SpacedOperators("SpacedOperators", regex::compile<R"(≥|≤|≠|=|:=|\+|-|\*|\/|▶)">);
+const Pattern Patterns::UnaryMinusAfterOperator("UnaryMinusAfterOperator", regex::compile<R"(([≥≤≠=\+|\-|\*|\/]) +- +)">);
+const Pattern Patterns::UnaryMinusAfterBracket("UnaryMinusAfterBracket", regex::compile<R"(([({[]) +- +)">);
+const Pattern Patterns::LocalInitialisation("LocalInitialisation", regex::compile<R"(LOCAL [A-Za-z]\w* = )">);
+const Pattern Patterns::SpacedEquals("SpacedEquals", regex::compile<R"( = )">);
+const Pattern Patterns::SemicolonKeyword("SemicolonKeyword", regex::compile<R"(;(END|WHILE)\b)">);
+const Pattern Patterns::LogicalKeyword("LogicalKeyword", regex::compile<R"(\b *(AND|OR|NOT) *\b)">);
+const Pattern Patterns::EndStatement("EndStatement", regex::compile<R"(^ *END;$)">);
+const Pattern Patterns::LeadingLocal("LeadingLocal", regex::compile<R"(^ *LOCAL +)">);
+const Pattern Patterns::BlockKeyword("BlockKeyword", regex::compile<R"(\b(BEGIN|IF|WHILE|REPEAT|CASE|ELSE|DEFAULT)\b)">);
+
+// MARK: - Source Blocks
+
+const Pattern Patterns::PythonBlock("PythonBlock", regex::compile<R"(^ *# *PYTHON *(\/\/.*)?$)">);
+const Pattern Patterns::PPLBlock("PPLBlock", regex::compile<R"(^ *# *PPL *(\/\/.*)?$)">);
+const Pattern Patterns::EndBlock("EndBlock", regex::compile<R"(^ *# *(END) *(?:\/\/.*)?$)">);
+const Pattern Patterns::BlockCommentStart("BlockCommentStart", regex::compile<R"(^ *\/\* *)">);
+const Pattern Patterns::BlockCommentEnd("BlockCommentEnd", regex::compile<R"( *\*\/(.*)$)">);
+const Pattern Patterns::InlineBlockComment("InlineBlockComment", regex::compile<R"(\/\*(.*)(?:(\*\/)))">);
+const Pattern Patterns::LineComment("LineComment", regex::compile<R"(\/\/.*$)">);
+const Pattern Patterns::FileExtension("FileExtension", regex::compile<R"(.\w*$)">);
+
+// MARK: - Preprocessor
+
+const Pattern Patterns::EndDirective("EndDirective", regex::compile<R"(^ *#END\b)", regex::ICase>);
+const Pattern Patterns::PythonDirective("PythonDirective", regex::compile<R"(^ *#PYTHON\b)">);
+const Pattern Patterns::PPLDirective("PPLDirective", regex::compile<R"(^ *#PPL\b)">);
+const Pattern Patterns::IncludeDirective("IncludeDirective", regex::compile<R"(^ *#include +)">);
+const Pattern Patterns::IncludeSystemFile("IncludeSystemFile", regex::compile<R"(^ *#include +<([^<>:"\|\?\*]*)>)">);
+const Pattern Patterns::IncludeLocalFile("IncludeLocalFile", regex::compile<R"(^ *#include +"([^<>:"\|\?\*]*)\")">);
+const Pattern Patterns::DefineDirective("DefineDirective", regex::compile<R"(^ *#define +([A-Za-z_]\w*)(?:\(([A-Za-z_ ,]+)\))? *(.*))">);
+const Pattern Patterns::UndefDirective("UndefDirective", regex::compile<R"(^ *#undef +([a-zA-Z_][\w.:]*) *$)">);
+const Pattern Patterns::PragmaDirective("PragmaDirective", regex::compile<R"((?:^ *#pragma +)\((.*)\) *$)">);
+const Pattern Patterns::IfdefDirective("IfdefDirective", regex::compile<R"(^\ *#ifdef +([A-Za-z_]\w*) *$)">);
+const Pattern Patterns::IfndefDirective("IfndefDirective", regex::compile<R"(^\ *#ifndef +([A-Za-z_]\w*) *$)">);
+const Pattern Patterns::IfDirective("IfDirective", regex::compile<R"(#if +([A-Za-z_]\w*) *(==|!=|>=|<=|>|<) *(.+)$)">);
+const Pattern Patterns::ElseDirective("ElseDirective", regex::compile<R"(^ *#else\b *((\/\/.*)|)$)">);
+const Pattern Patterns::EndifDirective("EndifDirective", regex::compile<R"(^ *#endif\b *((\/\/.*)|)$)">);
+
+// MARK: - Switch
+
+const Pattern Patterns::SwitchStatement("SwitchStatement", regex::compile<R"(\bswitch *\((.+)\) *\{ *$)">);
+const Pattern Patterns::CaseLabel("CaseLabel", regex::compile<R"(\bCASE *(\-?\d+) *\:)">);
+const Pattern Patterns::BreakStatement("BreakStatement", regex::compile<R"(\bBREAK;)">);
+const Pattern Patterns::DefaultLabel("DefaultLabel", regex::compile<R"(\bDEFAULT:)">);
@@ -0,0 +1,267 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef PATTERNS_HPP
+#define PATTERNS_HPP
+
+#include <iostream>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+
+#include "regex.hpp"
+
+namespace pp {
+    class Pattern;
+    
+    /*
+     The result of a search, in the manner of std::smatch: group 0 is the whole of the match
+     and positions are counted from the start of the string that was searched.
+     */
+    class Match {
+    public:
+        typedef struct TGroup {
+            const char *first = nullptr;
+            const char *second = nullptr;
+            bool matched = false;
+            
+            size_t length() const { return second - first; }
+            std::string str() const { return matched ? std::string(first, second) : std::string(); }
+            operator std::string() const { return str(); }
+        } TGroup;
+        
+        size_t size() const { return _size; }
+        bool empty() const { return _size == 0; }
+        
+        TGroup operator[](size_t n) const;
+        size_t position(size_t n = 0) const;
+        size_t length(size_t n = 0) const { return (*this)[n].length(); }
+        std::string str(size_t n = 0) const { return (*this)[n].str(); }
+        
+    private:
+        friend class Pattern;
+        friend class MatchIterator;
+        
+        const char *_begin = nullptr;
+        const char *_last = nullptr;
+        size_t _size = 0;
+        const char *_captures[regex::MaxGroups * 2] = {};
+    };
+    
+    // Iterates over every match in a string, in the manner of std::sregex_iterator.
+    class MatchIterator {
+    public:
+        MatchIterator() = default;
+        
+        const Match& operator*() const { return _match; }
+        const Match *operator->() const { return &_match; }
+        MatchIterator& operator++();
+        
+        bool operator==(const MatchIterator& other) const;
+        bool operator!=(const MatchIterator& other) const { return !(*this == other); }
+        
+    private:
+        friend class Pattern;
+        
+        const Pattern *_pattern = nullptr;
+        Match _match;
+    };
+    
+    // Iterates over the chosen groups of every match in a string, in the manner of std::sregex_token_iterator.
+    class TokenIterator {
+    public:
+        TokenIterator() = default;
+        
+        std::string operator*() const { return _it->str(_submatches[_n]); }
+        TokenIterator& operator++();
+        TokenIterator operator++(int);
+        
+        bool operator==(const TokenIterator& other) const { return _it == other._it && _n == other._n; }
+        bool operator!=(const TokenIterator& other) const { return !(*this == other); }
+        
+    private:
+        friend class Pattern;
+        
+        MatchIterator _it;
+        int _submatches[regex::MaxGroups] = {};
+        size_t _count = 0;
+        size_t _n = 0;
+    };
+    
+    /*
+     A fixed regular expression that is compiled into a matcher of its own when p+ is built, see
+     regex.hpp, and then shared by every module of the compiler.
+     
+     Every pattern registers itself with the pattern registry and keeps a count of how often it
+     was run and how often a run found a match.
+     */
+    class Pattern {
+    public:
+        typedef bool (*TSearch)(const char *begin, const char *first, const char *last, const char **captures, unsigned mode);
+        
+        const std::string name;
+        const std::string expression;
+        const bool caseless;
+        
+        template <regex::Literal E, unsigned F>
+        Pattern(const std::string& name, regex::Compiled<E, F>) : Pattern(name, E.data, F & regex::ICase, &regex::Compiled<E, F>::search, regex::Compiled<E, F>::program.groups) {}
+        
+        bool search(const std::string& str) const;
+        bool search(const std::string& str, Match& match) const;
+        bool search(std::string_view str) const;
+        bool match(const std::string& str) const;
+        bool match(const std::string& str, Match& match) const;
+        std::string replace(const std::string& str, const std::string& format) const;
+        
+        MatchIterator iterator(const std::string& str) const;
+        MatchIterator iterator(const std::string&& str) const = delete;
+        TokenIterator tokenIterator(const std::string& str, std::initializer_list<int> submatches) const;
+        TokenIterator tokenIterator(const std::string&& str, std::initializer_list<int> submatches) const = delete;
+        
+        uint64_t runs() const { return _runs; }
+        uint64_t matches() const { return _matches; }
+        
+        // Every registered pattern, in the order they were defined.
+        static const std::vector<const Pattern *>& all(void);
+        
+        // Prints the run and match counters of every registered pattern.
+        static void dumpStatistics(std::ostream& os);
+        
+    private:
+        friend class MatchIterator;
+        
+        const TSearch _search;
+        const int _groups;
+        mutable std::atomic<uint64_t> _runs = 0;
+        mutable std::atomic<uint64_t> _matches = 0;
+        
+        Pattern(const std::string& name, const char *expression, bool caseless, TSearch search, int groups);
+        
+        bool find(const char *begin, const char *first, const char *last, Match& match, unsigned mode) const;
+        bool count(bool matched) const;
+        
+        Pattern(const Pattern&);
+        Pattern& operator=(const Pattern&);
+    };
+    
+    namespace Patterns {
+        // MARK: - Shared
+        extern const Pattern CommaSeparated;
+        extern const Pattern String;
+        extern const Pattern ClosingBraceOnly;
+        
+        // MARK: - Prime-C To PPL Translater
+        extern const Pattern WhitespaceAroundOperators;
+        extern const Pattern CompoundAssignment;
+        extern const Pattern Modulo;
+        extern const Pattern TemplateSyntax;
+        extern const Pattern TypeCastingSyntax;
+        extern const Pattern AssignedExpression;
+        extern const Pattern AssignedArithmetic;
+        extern const Pattern FunctionArguments;
+        extern const Pattern PragmaMode;
+        extern const Pattern ListDeclaration;
+        extern const Pattern ConstLocal;
+        extern const Pattern Sleep;
+        extern const Pattern Subscript;
+        extern const Pattern LiteralSubscript;
+        extern const Pattern AdjacentSubscripts;
+        extern const Pattern LocalArrayDeclaration;
+        extern const Pattern ElseLine;
+        extern const Pattern OpeningBraceLine;
+        extern const Pattern ClosingBraceLine;
+        extern const Pattern ScopeOpening;
+        extern const Pattern ScopeClosing;
+        extern const Pattern LoopCondition;
+        extern const Pattern Assignment;
+        extern const Pattern KeyName;
+        extern const Pattern ExportOrLocal;
+        extern const Pattern Main;
+        extern const Pattern ForStatement;
+        extern const Pattern IfStatement;
+        extern const Pattern WhileStatement;
+        extern const Pattern RepeatStatement;
+        extern const Pattern SpacedAssignment;
+        extern const Pattern PushBack;
+        extern const Pattern Front;
+        extern const Pattern Back;
+        extern const Pattern Length;
+        extern const Pattern At;
+        
+        // MARK: - PPL Formatting
+        extern const Pattern Comma;
+        extern const Pattern OpeningBrace;
+        extern const Pattern ClosingBrace;
+        extern const Pattern ClosingBraceStatement;
+        extern const Pattern EmptyBraces;
+        extern const Pattern DoubleEquals;
+        extern const Pattern SpacedOperators;
+        extern const Pattern UnaryMinusAfterOperator;
+        extern const Pattern UnaryMinusAfterBracket;
+        extern const Pattern LocalInitialisation;
+        extern const Pattern SpacedEquals;
+        extern const Pattern SemicolonKeyword;
+        extern const Pattern LogicalKeyword;
+        extern const Pattern EndStatement;
+        extern const Pattern LeadingLocal;
+        extern const Pattern BlockKeyword;
+        
+        // MARK: - Source Blocks
+        extern const Pattern PythonBlock;
+        extern const Pattern PPLBlock;
+        extern const Pattern EndBlock;
+        extern const Pattern BlockCommentStart;
+        extern const Pattern BlockCommentEnd;
+        extern const Pattern InlineBlockComment;
+        extern const Pattern LineComment;
+        extern const Pattern FileExtension;
+        
+        // MARK: - Preprocessor
+        extern const Pattern EndDirective;
+        extern const Pattern PythonDirective;
+        extern const Pattern PPLDirective;
+        extern const Pattern IncludeDirective;
+        extern const Pattern IncludeSystemFile;
+        extern const Pattern IncludeLocalFile;
+        extern const Pattern DefineDirective;
+        extern const Pattern UndefDirective;
+        extern const Pattern PragmaDirective;
+        extern const Pattern IfdefDirective;
+        extern const Pattern IfndefDirective;
+        extern const Pattern IfDirective;
+        extern const Pattern ElseDirective;
+        extern const Pattern EndifDirective;
+        
+        // MARK: - Switch
+        extern const Pattern SwitchStatement;
+        extern const Pattern CaseLabel;
+        extern const Pattern BreakStatement;
+        extern const Pattern DefaultLabel;
+    }
+}
+
+#endif /* PATTERNS_HPP */
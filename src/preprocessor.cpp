@@ -24,33 +24,28 @@
 
 
 #include "preprocessor.hpp"
-#include "singleton.hpp"
+#include "context.hpp"
 #include "common.hpp"
+#include "patterns.hpp"
 
-#include <regex>
 #include <sstream>
 #include <fstream>
 #include <cctype>
 
 using namespace pp;
 
-static Singleton* _singleton  = Singleton::shared();
-
 
 bool Preprocessor::parse(std::string& str) {
     std::string s;
-    std::regex re;
-    std::smatch match;
-    std::sregex_token_iterator it;
-    std::sregex_token_iterator end;
+    TokenIterator it;
+    TokenIterator end;
     Aliases::TIdentity  identity;
     pathname = std::string("");
     
-    if (regex_search(str, std::regex(R"(^ *#END\b)", std::regex_constants::icase))) {
+    if (Patterns::EndDirective.search(str)) {
         if (_nesting.size() == 0) {
-            std::cout << MessageType::CriticalError << "unexpected #end\n";
-            exit(-1);
-            return false;
+            _context.log << MessageType::CriticalError << "unexpected #end\n";
+            return true;
         }
         if (std::string::npos != _nesting.back().compare("#PYTHON")) {
             python = false;
@@ -66,13 +61,13 @@ bool Preprocessor::parse(std::string& str) {
     }
     
     
-    if (regex_search(str, std::regex(R"(^ *#PYTHON\b)"))) {
+    if (Patterns::PythonDirective.search(str)) {
         _nesting.push_back(std::string("#PYTHON"));
         python=true;
         return true;
     }
     
-    if (regex_search(str, std::regex(R"(^ *#PPL\b)"))) {
+    if (Patterns::PPLDirective.search(str)) {
         _nesting.push_back(std::string("#PPL"));
         ppl=true;
         return true;
@@ -80,33 +75,26 @@ bool Preprocessor::parse(std::string& str) {
     
     
     if (disregard == false) {
-        re = R"(^ *#include +)";
-        if (regex_search(str, re)) {
-            std::sregex_token_iterator it;
-            const std::sregex_token_iterator end;
+        if (Patterns::IncludeDirective.search(str)) {
+            TokenIterator it;
+            const TokenIterator end;
             
-            re = R"(^ *#include +<([^<>:"\|\?\*]*)>)";
-            it = std::sregex_token_iterator {
-                str.begin(), str.end(), re, {1}
-            };
+            it = Patterns::IncludeSystemFile.tokenIterator(str, {1});
             if (it != end) {
                 pathname = *it++;
                 pathname = path + pathname;
                 if (std::string::npos == pathname.rfind('.')) pathname += ".pplib";
-                if (verbose) std::cout << MessageType::Verbose << "#include: file named '" << pathname << "'\n";
+                if (verbose) _context.log << MessageType::Verbose << "#include: file named '" << pathname << "'\n";
                 return true;
             }
             
-            re = R"(^ *#include +"([^<>:"\|\?\*]*)\")";
-            it = std::sregex_token_iterator {
-                str.begin(), str.end(), re, {1}
-            };
+            it = Patterns::IncludeLocalFile.tokenIterator(str, {1});
             if (it != end) {
                 pathname = *it++;
                 if (!file_exists(pathname)) {
-                    pathname = _singleton->currentPathname().substr(0, _singleton->currentPathname().rfind("/") + 1) + pathname;
+                    pathname = _context.currentPathname().substr(0, _context.currentPathname().rfind("/") + 1) + pathname;
                 }
-                if (verbose) std::cout << MessageType::Verbose << "#include: file named '" << pathname << "'\n";
+                if (verbose) _context.log << MessageType::Verbose << "#include: file named '" << pathname << "'\n";
                 return true;
             }
             return false;
@@ -119,10 +107,7 @@ bool Preprocessor::parse(std::string& str) {
                 2 a,b,c
                 3 c := a+b
          */
-        re = R"(^ *#define +([A-Za-z_]\w*)(?:\(([A-Za-z_ ,]+)\))? *(.*))";
-        it = std::sregex_token_iterator {
-            str.begin(), str.end(), re, {1, 2, 3}
-        };
+        it = Patterns::DefineDirective.tokenIterator(str, {1, 2, 3});
         if (it != end) {
             identity.identifier = *it++;
             identity.parameters = *it++;
@@ -132,8 +117,8 @@ bool Preprocessor::parse(std::string& str) {
             identity.scope = Aliases::Scope::Global;
             identity.type = Aliases::Type::Macro;
             
-            _singleton->aliases.append(identity);
-            if (verbose) std::cout << MessageType::Verbose << "#define: " << identity.identifier << '\n';
+            _context.aliases.append(identity);
+            if (verbose) _context.log << MessageType::Verbose << "#define: " << identity.identifier << '\n';
             return true;
         }
  
@@ -144,33 +129,30 @@ bool Preprocessor::parse(std::string& str) {
          */
         // #undef
         
-        re = R"(^ *#undef +([a-zA-Z_][\w.:]*) *$)";
-        it = std::sregex_token_iterator {
-            str.begin(), str.end(), re, {1}
-        };
+        it = Patterns::UndefDirective.tokenIterator(str, {1});
         if (it != end) {
-            _singleton->aliases.remove(*it);
-            if (verbose) std::cout << MessageType::Verbose << "#undef: " << *it << '\n';
+            _context.aliases.remove(*it);
+            if (verbose) _context.log << MessageType::Verbose << "#undef: " << *it << '\n';
             return true;
         }
         
         
         // #pragma
-        re = R"((?:^ *#pragma +)\((.*)\) *$)";
-        it = std::sregex_token_iterator {
-            str.begin(), str.end(), re, {1}
-        };
+        it = Patterns::PragmaDirective.tokenIterator(str, {1});
         if (it != end) {
             s = *it;
-            re = R"([^,]+(?=[^,]*))";
-            for(std::sregex_iterator it = std::sregex_iterator(s.begin(), s.end(), re); it != std::sregex_iterator(); ++it) {
+            for(MatchIterator it = Patterns::CommaSeparated.iterator(s); it != MatchIterator(); ++it) {
                 std::string pragma = trim_copy(it->str());
                 
                 if (pragma == "verbose aliases") {
-                    Singleton::shared()->aliases.verbose = !Singleton::shared()->aliases.verbose;
+                    _context.aliases.verbose = !_context.aliases.verbose;
+                }
+                
+                if (pragma == "inline") {
+                    inlining = true;
                 }
            
-                if (verbose) std::cout << MessageType::Verbose << "#pragma: " << pragma << '\n';
+                if (verbose) _context.log << MessageType::Verbose << "#pragma: " << pragma << '\n';
             }
             return true;
         }
@@ -180,14 +162,11 @@ bool Preprocessor::parse(std::string& str) {
          Group  0 #ifdef NAME
                 1 NAME
          */
-        re = R"(^\ *#ifdef +([A-Za-z_]\w*) *$)";
-        it = std::sregex_token_iterator {
-            str.begin(), str.end(), re, {1}
-        };
+        it = Patterns::IfdefDirective.tokenIterator(str, {1});
         if (it != end) {
             identity.identifier = *it;
-            disregard = !_singleton->aliases.exists(identity);
-            if (verbose) std::cout << MessageType::Verbose << "#ifdef: " << identity.identifier << " is " << (!disregard ? "true" : "false") << '\n';
+            disregard = !_context.aliases.exists(identity);
+            if (verbose) _context.log << MessageType::Verbose << "#ifdef: " << identity.identifier << " is " << (!disregard ? "true" : "false") << '\n';
             return true;
         }
         
@@ -196,25 +175,19 @@ bool Preprocessor::parse(std::string& str) {
          Group  0 #ifndef NAME
                 1 NAME
          */
-        re = R"(^\ *#ifndef +([A-Za-z_]\w*) *$)";
-        it = std::sregex_token_iterator {
-            str.begin(), str.end(), re, {1}
-        };
+        it = Patterns::IfndefDirective.tokenIterator(str, {1});
         if (it != end) {
             identity.identifier = *it;
             
-            disregard = _singleton->aliases.exists(identity);
-            if (verbose) std::cout << MessageType::Verbose << "#ifndef: " << identity.identifier << " is " << (!disregard ? "true" : "false") << '\n';
+            disregard = _context.aliases.exists(identity);
+            if (verbose) _context.log << MessageType::Verbose << "#ifndef: " << identity.identifier << " is " << (!disregard ? "true" : "false") << '\n';
             return true;
         }
         
         
-        re = R"(#if +([A-Za-z_]\w*) *(==|!=|>=|<=|>|<) *(.+)$)";
-        it = std::sregex_token_iterator {
-            str.begin(), str.end(), re, {1,2,3}
-        };
+        it = Patterns::IfDirective.tokenIterator(str, {1,2,3});
         if (it != end) {
-            identity = _singleton->aliases.getIdentity(*it++);
+            identity = _context.aliases.getIdentity(*it++);
             if (identity.identifier.empty()) return true;
             std::string op = *it++;
             std::string real = *it;
@@ -231,15 +204,15 @@ bool Preprocessor::parse(std::string& str) {
         }
     }
     
-    if (regex_search(str, std::regex(R"(^ *#else\b *((\/\/.*)|)$)"))) {
+    if (Patterns::ElseDirective.search(str)) {
         disregard = !disregard;
-        if (verbose) std::cout << MessageType::Verbose << "#else: " << disregard << '\n';
+        if (verbose) _context.log << MessageType::Verbose << "#else: " << disregard << '\n';
         return true;
     }
     
-    if (regex_search(str, std::regex(R"(^ *#endif\b *((\/\/.*)|)$)"))) {
+    if (Patterns::EndifDirective.search(str)) {
         disregard = false;
-        if (verbose) std::cout << MessageType::Verbose << "#endif: " << disregard << '\n';
+        if (verbose) _context.log << MessageType::Verbose << "#endif: " << disregard << '\n';
         return true;
     }
     
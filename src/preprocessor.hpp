@@ -29,6 +29,8 @@
 #include "aliases.hpp"
 
 namespace pp {
+    class Context;
+    
     class Preprocessor {
     public:
         std::string path;       // path for #include <‘filename‘>
@@ -41,10 +43,14 @@ namespace pp {
         bool ppl = false;
         bool operators = true;
         bool logicalOperators = true;
+        bool inlining = false;
+        
+        Preprocessor(Context& context) : _context(context) {}
         
         bool parse(std::string& str);
         
     private:
+        Context& _context;
         std::list<std::string> _nesting;
     };
     
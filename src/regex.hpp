@@ -0,0 +1,620 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef REGEX_HPP
+#define REGEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ A regular expression engine for patterns that are known when p+ itself is compiled.
+ 
+ The expression, a string literal passed as a template argument, is parsed by the C++ compiler
+ into a program of nodes, and each node of the program is then instantiated as a function that
+ matches exactly that node and calls on to the next, so that a pattern becomes a specialised
+ backtracking matcher with no parsing, allocation or interpretation left for run time.
+ 
+ Matching follows std::regex's ECMAScript grammar, byte for byte, for the subset of it that p+
+ uses: literals, ., classes, \d \w \s \D \W \S, \b \B, ^ and $, capturing and (?:) groups,
+ (?=) and (?!) lookaheads, alternation and the greedy quantifiers * + ? {n} {n,} and {n,m}.
+ Anything else is rejected when p+ is compiled.
+ */
+namespace pp {
+    namespace regex {
+        enum Flags : unsigned {
+            None = 0,
+            ICase = 1
+        };
+        
+        enum Mode : unsigned {
+            Search = 0,
+            Anchored = 1,   // only a match starting at first
+            Full = 2,       // only a match ending at last
+            NotNull = 4     // only a match that is not empty
+        };
+        
+        // Including group 0, the whole of the match.
+        constexpr int MaxGroups = 10;
+        
+        template <size_t N>
+        struct Literal {
+            char data[N];
+            
+            constexpr Literal(const char (&s)[N]) {
+                for (size_t i = 0; i < N; ++i) data[i] = s[i];
+            }
+            
+            constexpr size_t size() const { return N - 1; }
+        };
+        
+        // MARK: - Program
+        
+        enum class Op : uint8_t {
+            Char,
+            Set,
+            Begin,
+            End,
+            Boundary,
+            Group,
+            Alternation,
+            Branch,
+            Repeat,
+            Lookahead
+        };
+        
+        typedef struct Node {
+            Op op = Op::Char;
+            unsigned char c = 0;
+            bool negate = false;        // \B and (?!
+            int group = -1;             // -1 for a (?:) group
+            int min = 0;
+            int max = -1;               // -1 for no upper bound
+            int child = -1;             // body of a group, repeat or lookahead, first branch of an alternation
+            int next = -1;              // next node in sequence, -1 at the end of one
+            int alternative = -1;       // next branch of an alternation
+            uint64_t bits[4] = {};
+            
+            constexpr bool contains(unsigned char ch) const {
+                return (bits[ch >> 6] >> (ch & 63)) & 1;
+            }
+            
+            constexpr void insert(unsigned char ch) {
+                bits[ch >> 6] |= uint64_t(1) << (ch & 63);
+            }
+            
+            constexpr void insert(unsigned char lo, unsigned char hi) {
+                for (unsigned ch = lo; ch <= hi; ++ch) insert(ch);
+            }
+            
+            constexpr void invert(void) {
+                for (auto& b : bits) b = ~b;
+            }
+        } Node;
+        
+        template <size_t N>
+        struct Program {
+            Node nodes[N] = {};
+            int size = 0;
+            int root = -1;
+            int groups = 1;
+            bool anchored = false;      // can only match at the start of the subject
+            bool nullable = false;      // can match the empty string
+            Node first = {};            // every byte a match can start with, when not nullable
+        };
+        
+        // MARK: - Parser
+        
+        template <size_t N>
+        class Parser {
+        public:
+            Program<N> program;
+            
+            constexpr Parser(const char *s, size_t length, unsigned flags) : _s(s), _length(length), _flags(flags) {
+                program.root = alternation();
+                if (_i != _length) throw "regex: unmatched ')'";
+                if (program.groups > MaxGroups) throw "regex: too many groups";
+                
+                program.anchored = program.root >= 0 && program.nodes[program.root].op == Op::Begin;
+                program.nullable = firsts(program.root, program.first);
+            }
+            
+        private:
+            const char *_s;
+            size_t _length;
+            size_t _i = 0;
+            unsigned _flags;
+            
+            constexpr bool more(void) const { return _i < _length; }
+            constexpr char peek(size_t offset = 0) const { return _i + offset < _length ? _s[_i + offset] : 0; }
+            
+            constexpr bool consume(char c) {
+                if (peek() != c || !more()) return false;
+                _i++;
+                return true;
+            }
+            
+            constexpr int add(const Node& node) {
+                if (program.size == (int)N) throw "regex: program too large";
+                program.nodes[program.size] = node;
+                return program.size++;
+            }
+            
+            constexpr int alternation(void) {
+                int first = sequence();
+                if (!more() || peek() != '|') return first;
+                
+                Node node;
+                node.op = Op::Alternation;
+                int alternation = add(node);
+                
+                node.op = Op::Branch;
+                node.child = first;
+                int branch = add(node);
+                program.nodes[alternation].child = branch;
+                
+                while (consume('|')) {
+                    node.child = sequence();
+                    int next = add(node);
+                    program.nodes[branch].alternative = next;
+                    branch = next;
+                }
+                return alternation;
+            }
+            
+            constexpr int sequence(void) {
+                int head = -1, tail = -1;
+                
+                while (more() && peek() != '|' && peek() != ')') {
+                    int node = quantified(atom());
+                    if (head < 0) head = node; else program.nodes[tail].next = node;
+                    tail = node;
+                }
+                return head;
+            }
+            
+            constexpr int number(void) {
+                if (peek() < '0' || peek() > '9') throw "regex: bad quantifier";
+                int n = 0;
+                while (peek() >= '0' && peek() <= '9') n = n * 10 + _s[_i++] - '0';
+                return n;
+            }
+            
+            constexpr int quantified(int atom) {
+                Node node;
+                node.op = Op::Repeat;
+                node.child = atom;
+                
+                if (consume('*')) {
+                    node.min = 0;
+                } else if (consume('+')) {
+                    node.min = 1;
+                } else if (consume('?')) {
+                    node.max = 1;
+                } else if (consume('{')) {
+                    node.min = node.max = number();
+                    if (consume(',')) node.max = peek() == '}' ? -1 : number();
+                    if (!consume('}') || (node.max >= 0 && node.max < node.min)) throw "regex: bad quantifier";
+                } else {
+                    return atom;
+                }
+                
+                if (peek() == '?') throw "regex: lazy quantifiers are not supported";
+                return add(node);
+            }
+            
+            constexpr void word(Node& node) {
+                node.insert('a', 'z');
+                node.insert('A', 'Z');
+                node.insert('0', '9');
+                node.insert('_');
+            }
+            
+            constexpr void space(Node& node) {
+                node.insert(' ');
+                node.insert('\t', '\r');
+            }
+            
+            // Adds \d \w \s or their complements, returning false for any other escape.
+            constexpr bool shorthand(char c, Node& node) {
+                Node set;
+                switch (c) {
+                    case 'd': case 'D': set.insert('0', '9'); break;
+                    case 'w': case 'W': word(set); break;
+                    case 's': case 'S': space(set); break;
+                    default: return false;
+                }
+                if (c >= 'A' && c <= 'Z') set.invert();
+                for (int i = 0; i < 4; ++i) node.bits[i] |= set.bits[i];
+                return true;
+            }
+            
+            constexpr unsigned char escaped(char c) const {
+                switch (c) {
+                    case 'n': return '\n';
+                    case 'r': return '\r';
+                    case 't': return '\t';
+                    case 'f': return '\f';
+                    case 'v': return '\v';
+                    case '0': return '\0';
+                    default: return c;
+                }
+            }
+            
+            constexpr void caseless(Node& node) {
+                if (!(_flags & ICase)) return;
+                for (unsigned char c = 'a'; c <= 'z'; ++c) {
+                    if (node.contains(c) || node.contains(c - 'a' + 'A')) {
+                        node.insert(c);
+                        node.insert(c - 'a' + 'A');
+                    }
+                }
+            }
+            
+            constexpr int literal(unsigned char c) {
+                Node node;
+                if (_flags & ICase && ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))) {
+                    node.op = Op::Set;
+                    node.insert(c);
+                    caseless(node);
+                    return add(node);
+                }
+                node.c = c;
+                return add(node);
+            }
+            
+            constexpr int set(void) {
+                Node node;
+                node.op = Op::Set;
+                bool negate = consume('^');
+                
+                for (;;) {
+                    if (!more()) throw "regex: unmatched '['";
+                    unsigned char lo = _s[_i++];
+                    if (lo == ']') break;
+                    
+                    if (lo == '\\') {
+                        if (!more()) throw "regex: trailing '\\'";
+                        char c = _s[_i++];
+                        if (shorthand(c, node)) continue;
+                        lo = c == 'b' ? '\b' : escaped(c);
+                    }
+                    
+                    if (peek() == '-' && peek(1) != ']' && _i + 1 < _length) {
+                        _i++;
+                        unsigned char hi = _s[_i++];
+                        if (hi == '\\') {
+                            if (!more()) throw "regex: trailing '\\'";
+                            hi = escaped(_s[_i++]);
+                        }
+                        if (hi < lo) throw "regex: bad range";
+                        node.insert(lo, hi);
+                        continue;
+                    }
+                    node.insert(lo);
+                }
+                
+                caseless(node);
+                if (negate) node.invert();
+                return add(node);
+            }
+            
+            constexpr int atom(void) {
+                Node node;
+                char c = _s[_i++];
+                
+                switch (c) {
+                    case '(':
+                        node.op = Op::Group;
+                        if (consume('?')) {
+                            if (consume('=')) {
+                                node.op = Op::Lookahead;
+                            } else if (consume('!')) {
+                                node.op = Op::Lookahead;
+                                node.negate = true;
+                            } else if (!consume(':')) {
+                                throw "regex: unsupported group";
+                            }
+                        } else {
+                            node.group = program.groups++;
+                        }
+                        node.child = alternation();
+                        if (!consume(')')) throw "regex: unmatched '('";
+                        return add(node);
+                        
+                    case '[':
+                        return set();
+                        
+                    case '.':
+                        node.op = Op::Set;
+                        node.invert();
+                        node.bits[0] &= ~((uint64_t(1) << '\n') | (uint64_t(1) << '\r'));
+                        return add(node);
+                        
+                    case '^':
+                        node.op = Op::Begin;
+                        return add(node);
+                        
+                    case '$':
+                        node.op = Op::End;
+                        return add(node);
+                        
+                    case '\\':
+                        if (!more()) throw "regex: trailing '\\'";
+                        c = _s[_i++];
+                        if (c == 'b' || c == 'B') {
+                            node.op = Op::Boundary;
+                            node.negate = c == 'B';
+                            return add(node);
+                        }
+                        node.op = Op::Set;
+                        if (shorthand(c, node)) return add(node);
+                        if (c >= '1' && c <= '9') throw "regex: back-references are not supported";
+                        return literal(escaped(c));
+                        
+                    case '*': case '+': case '?': case '{':
+                        throw "regex: nothing to repeat";
+                        
+                    default:
+                        return literal(c);
+                }
+            }
+            
+            /*
+             Collects into set every byte that a match of the sequence starting at node can begin with,
+             returning true if the sequence can also match the empty string.
+             */
+            constexpr bool firsts(int node, Node& set) const {
+                for (; node >= 0; node = program.nodes[node].next) {
+                    const Node& n = program.nodes[node];
+                    
+                    switch (n.op) {
+                        case Op::Char:
+                            set.insert(n.c);
+                            return false;
+                            
+                        case Op::Set:
+                            for (int i = 0; i < 4; ++i) set.bits[i] |= n.bits[i];
+                            return false;
+                            
+                        case Op::Group:
+                            if (!firsts(n.child, set)) return false;
+                            break;
+                            
+                        case Op::Alternation: {
+                            bool nullable = false;
+                            for (int branch = n.child; branch >= 0; branch = program.nodes[branch].alternative) {
+                                if (firsts(program.nodes[branch].child, set)) nullable = true;
+                            }
+                            if (!nullable) return false;
+                            break;
+                        }
+                            
+                        case Op::Repeat:
+                            if (!firsts(n.child, set) && n.min > 0) return false;
+                            break;
+                            
+                        default:
+                            break;
+                    }
+                }
+                return true;
+            }
+        };
+        
+        template <Literal E, unsigned F>
+        constexpr auto parse(void) {
+            return Parser<E.size() * 3 + 4>(E.data, E.size(), F).program;
+        }
+        
+        // MARK: - Matcher
+        
+        typedef struct State {
+            const char *begin;          // start of the subject, for ^ and \b
+            const char *last;
+            const char **captures;
+        } State;
+        
+        inline bool isWord(char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+        }
+        
+        /*
+         Matches node I of program P at p and, if it does, the rest of its sequence, and then calls
+         the continuation k with the position reached. Returns as soon as any continuation succeeds,
+         which gives the leftmost, first-alternative, greedy match of ECMAScript.
+         */
+        template <const auto& P, int I, typename K>
+        inline bool step(State& s, const char *p, const K& k);
+        
+        template <const auto& P, int B, typename K>
+        inline bool branch(State& s, const char *p, const K& k) {
+            constexpr Node b = P.nodes[B];
+            if (step<P, b.child>(s, p, k)) return true;
+            if constexpr (b.alternative >= 0) return branch<P, b.alternative>(s, p, k);
+            else return false;
+        }
+        
+        // A repeat whose body is more than a single byte, with the empty-iteration rule of ECMAScript.
+        template <const auto& P, int I, typename K>
+        struct Loop {
+            State& s;
+            const K& k;
+            
+            bool operator()(const char *p, int count) const {
+                constexpr Node n = P.nodes[I];
+                constexpr int min = n.min;
+                
+                if (n.max < 0 || count < n.max) {
+                    auto again = [this, p, count](const char *q) {
+                        return (q != p || count < min) && (*this)(q, count + 1);
+                    };
+                    if (step<P, n.child>(s, p, again)) return true;
+                }
+                return count >= n.min && step<P, n.next>(s, p, k);
+            }
+        };
+        
+        template <const auto& P, int I, typename K>
+        inline bool step(State& s, const char *p, const K& k) {
+            if constexpr (I < 0) {
+                return k(p);
+            } else {
+                constexpr Node n = P.nodes[I];
+                
+                if constexpr (n.op == Op::Char) {
+                    return p != s.last && *p == (char)n.c && step<P, n.next>(s, p + 1, k);
+                }
+                
+                if constexpr (n.op == Op::Set) {
+                    return p != s.last && n.contains(*p) && step<P, n.next>(s, p + 1, k);
+                }
+                
+                if constexpr (n.op == Op::Begin) {
+                    return p == s.begin && step<P, n.next>(s, p, k);
+                }
+                
+                if constexpr (n.op == Op::End) {
+                    return p == s.last && step<P, n.next>(s, p, k);
+                }
+                
+                if constexpr (n.op == Op::Boundary) {
+                    bool boundary = (p != s.begin && isWord(p[-1])) != (p != s.last && isWord(*p));
+                    return boundary != n.negate && step<P, n.next>(s, p, k);
+                }
+                
+                if constexpr (n.op == Op::Group && n.group < 0) {
+                    if constexpr (n.next < 0) {
+                        return step<P, n.child>(s, p, k);
+                    } else {
+                        return step<P, n.child>(s, p, [&s, &k](const char *q) {
+                            return step<P, n.next>(s, q, k);
+                        });
+                    }
+                }
+                
+                if constexpr (n.op == Op::Group && n.group >= 0) {
+                    constexpr int g = n.group * 2;
+                    return step<P, n.child>(s, p, [&s, &k, p](const char *q) {
+                        const char *first = s.captures[g], *second = s.captures[g + 1];
+                        s.captures[g] = p;
+                        s.captures[g + 1] = q;
+                        if (step<P, n.next>(s, q, k)) return true;
+                        s.captures[g] = first;
+                        s.captures[g + 1] = second;
+                        return false;
+                    });
+                }
+                
+                if constexpr (n.op == Op::Alternation) {
+                    if constexpr (n.next < 0) {
+                        return branch<P, n.child>(s, p, k);
+                    } else {
+                        return branch<P, n.child>(s, p, [&s, &k](const char *q) {
+                            return step<P, n.next>(s, q, k);
+                        });
+                    }
+                }
+                
+                if constexpr (n.op == Op::Lookahead) {
+                    bool found = step<P, n.child>(s, p, [](const char *) { return true; });
+                    return found != n.negate && step<P, n.next>(s, p, k);
+                }
+                
+                if constexpr (n.op == Op::Repeat) {
+                    constexpr Node body = P.nodes[n.child];
+                    
+                    if constexpr ((body.op == Op::Char || body.op == Op::Set) && body.next < 0) {
+                        // A single byte repeated needs no recursion: take as many as allowed, then give them back one at a time.
+                        const char *q = p;
+                        long count = 0;
+                        while ((n.max < 0 || count < n.max) && q != s.last && (body.op == Op::Char ? *q == (char)body.c : body.contains(*q))) {
+                            q++;
+                            count++;
+                        }
+                        if (count < n.min) return false;
+                        for (;;) {
+                            if (step<P, n.next>(s, q, k)) return true;
+                            if (count == n.min) return false;
+                            q--;
+                            count--;
+                        }
+                    } else {
+                        return Loop<P, I, K>{s, k}(p, 0);
+                    }
+                }
+            }
+        }
+        
+        /*
+         Searches [first, last) for the leftmost match of program P, filling captures with a pair of
+         pointers for each group, null for a group that took no part in the match.
+         */
+        template <const auto& P>
+        bool search(const char *begin, const char *first, const char *last, const char **captures, unsigned mode) {
+            State s = {begin, last, captures};
+            const char *start = first;
+            
+            for (int i = 0; i < P.groups * 2; ++i) captures[i] = nullptr;
+            
+            auto accept = [&](const char *q) {
+                if ((mode & Full) && q != last) return false;
+                if ((mode & NotNull) && q == start) return false;
+                captures[0] = start;
+                captures[1] = q;
+                return true;
+            };
+            
+            for (;; ++start) {
+                if constexpr (P.anchored) {
+                    if (start != begin) return false;
+                }
+                if constexpr (!P.nullable) {
+                    if (!(mode & Anchored)) {
+                        while (start != last && !P.first.contains(*start)) start++;
+                    }
+                    if (start == last) return false;
+                }
+                if (step<P, P.root>(s, start, accept)) return true;
+                if ((mode & Anchored) || start == last) return false;
+            }
+        }
+        
+        // The type of pp::regex::compile<E, F>, from which a Pattern takes its matcher.
+        template <Literal E, unsigned F>
+        struct Compiled {
+            static constexpr auto program = parse<E, F>();
+            
+            static bool search(const char *begin, const char *first, const char *last, const char **captures, unsigned mode) {
+                return regex::search<program>(begin, first, last, captures, mode);
+            }
+        };
+        
+        template <Literal E, unsigned F = None>
+        inline constexpr Compiled<E, F> compile = {};
+    }
+}
+
+#endif /* REGEX_HPP */
@@ -0,0 +1,177 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#include "rewriter.hpp"
+#include "lexer.hpp"
+
+#include <cstring>
+
+using namespace pp;
+
+static bool isWordStart(const char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+}
+
+static bool isWordCharacter(const char c) {
+    return isWordStart(c) || (c >= '0' && c <= '9');
+}
+
+Rewriter::Rewriter(std::initializer_list<TRule> rules, bool lexical) : _lexical(lexical) {
+    _states.emplace_back();
+    std::fill(std::begin(_states.front().next), std::end(_states.front().next), -1);
+    
+    for (const TRule& rule : rules) insert(rule);
+    
+    // Operators of the lexer not otherwise replaced are kept as they are, but still take precedence over any shorter pattern.
+    if (_lexical) {
+        for (const char *const *op = Lexer::operators(); *op; ++op) {
+            size_t length;
+            if (longest(*op, 0, length) < 0 || length != strlen(*op)) insert({*op, *op, Kind::Anywhere});
+        }
+    }
+    
+    for (int c = 0; c < 256; ++c) {
+        bool special = c < 128 && _states.front().next[c] >= 0;
+        if (_lexical && (c == '"' || (c >= '0' && c <= '9'))) special = true;
+        _plain[c] = !special;
+    }
+}
+
+void Rewriter::insert(const TRule& rule) {
+    int state = 0;
+    
+    for (const char *p = rule.pattern; *p; ++p) {
+        char c = *p;
+        char other = c;
+        if (Kind::Word == rule.kind) {
+            if (c >= 'a' && c <= 'z') other = c - 'a' + 'A';
+            if (c >= 'A' && c <= 'Z') other = c - 'A' + 'a';
+        }
+        
+        int next = _states[state].next[(unsigned char)c];
+        if (next < 0) {
+            next = (int)_states.size();
+            _states.emplace_back();
+            std::fill(std::begin(_states.back().next), std::end(_states.back().next), -1);
+            _states[state].next[(unsigned char)c] = next;
+        }
+        _states[state].next[(unsigned char)other] = next;
+        state = next;
+    }
+    
+    if (Kind::Word == rule.kind) _words = true;
+    _states[state].rule = (int)_rules.size();
+    _rules.push_back(rule);
+}
+
+int Rewriter::longest(const std::string& str, size_t pos, size_t& length) const {
+    int state = 0;
+    int found = -1;
+    bool wordStart = pos == 0 || !isWordCharacter(str[pos - 1]);
+    
+    for (size_t i = pos; i < str.length(); ++i) {
+        unsigned char c = str[i];
+        if (c >= 128 || (state = _states[state].next[c]) < 0) break;
+        
+        int rule = _states[state].rule;
+        if (rule < 0) continue;
+        if (Kind::Word == _rules[rule].kind && (!wordStart || (i + 1 < str.length() && isWordCharacter(str[i + 1])))) continue;
+        
+        found = rule;
+        length = i + 1 - pos;
+    }
+    
+    return found;
+}
+
+/*
+ Rewrites the line in place for as long as every replacement is of the same length as what it
+ replaces, as a keyword is, only building a new line once one is not.
+ */
+void Rewriter::rewrite(std::string& str) const {
+    std::string result;
+    bool building = false;
+    size_t i = 0, n = str.length();
+    
+    auto copy = [&](size_t start, size_t end) {
+        if (building) result.append(str, start, end - start);
+    };
+    
+    while (i < n) {
+        size_t start = i;
+        
+        // Bytes that can start neither a pattern, a string nor a number are copied as a run.
+        while (i < n && _plain[(unsigned char)str[i]]) i++;
+        if (i > start) {
+            copy(start, i);
+            if (i == n) break;
+            start = i;
+        }
+        
+        char c = str[i];
+        bool inWord = i > 0 && isWordCharacter(str[i - 1]);
+        
+        if (_lexical && c == '"') {
+            i = str.find('"', i + 1);
+            i = i == std::string::npos ? n : i + 1;
+            copy(start, i);
+            continue;
+        }
+        
+        if (_lexical && c >= '0' && c <= '9' && !inWord) {
+            while (i < n && (isWordCharacter(str[i]) || str[i] == '.')) i++;
+            copy(start, i);
+            continue;
+        }
+        
+        size_t length;
+        int rule = longest(str, i, length);
+        if (rule >= 0) {
+            const char *replacement = _rules[rule].replacement;
+            size_t size = strlen(replacement);
+            
+            if (!building && size != length) {
+                result.reserve(n + n / 4);
+                result.assign(str, 0, i);
+                building = true;
+            }
+            if (building) result.append(replacement, size); else str.replace(i, length, replacement, size);
+            i += length;
+            continue;
+        }
+        
+        // No word can be found within another word, so the rest of this one is passed over.
+        if (_words && isWordCharacter(c)) {
+            while (i < n && isWordCharacter(str[i])) i++;
+            copy(start, i);
+            continue;
+        }
+        
+        copy(i, i + 1);
+        i++;
+    }
+    
+    if (building) str.swap(result);
+}
@@ -0,0 +1,82 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef REWRITER_HPP
+#define REWRITER_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <initializer_list>
+
+namespace pp {
+    /*
+     Replaces a fixed set of keywords and operators in a single left-to-right scan of a line.
+     
+     The patterns are built once into an automaton, a trie with a dense table of transitions,
+     which is walked from each position that a match may start at for the longest pattern found
+     there, the replacement then being emitted straight into the rewritten line.
+     
+     A lexical rewriter splits the line exactly as the lexer would: strings and numbers are left
+     alone, and every multi-character operator of the lexer is a pattern in its own right, so that
+     `>=` is never found within `>>=`.
+     */
+    class Rewriter {
+    public:
+        enum class Kind {
+            Anywhere,   // matched wherever it appears
+            Word        // matched, ignoring case, only as a whole word
+        };
+        
+        typedef struct TRule {
+            const char *pattern;
+            const char *replacement;
+            Kind kind;
+        } TRule;
+        
+        Rewriter(std::initializer_list<TRule> rules, bool lexical);
+        
+        void rewrite(std::string& str) const;
+        
+    private:
+        typedef struct TState {
+            int next[128];
+            int rule = -1;
+        } TState;
+        
+        std::vector<TState> _states;
+        std::vector<TRule> _rules;
+        bool _lexical;
+        bool _words = false;
+        bool _plain[256];                   // bytes that never start a match, string or number
+        
+        void insert(const TRule& rule);
+        
+        // The rule of the longest pattern found at pos, or -1, along with its length.
+        int longest(const std::string& str, size_t pos, size_t& length) const;
+    };
+}
+
+#endif /* REWRITER_HPP */
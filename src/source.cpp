@@ -0,0 +1,102 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#include "source.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace pp;
+
+Source::~Source() {
+    close();
+}
+
+bool Source::open(const std::string& pathname) {
+    close();
+    this->pathname = pathname;
+    
+    int fd = ::open(pathname.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            _data = (const char *)data;
+            _size = st.st_size;
+            _mapped = true;
+        }
+    }
+    ::close(fd);
+    
+    if (!_mapped) {
+        std::ifstream infile(pathname, std::ios::in | std::ios::binary);
+        if (!infile.is_open()) return false;
+        
+        std::ostringstream contents;
+        contents << infile.rdbuf();
+        _contents = contents.str();
+        _data = _contents.data();
+        _size = _contents.size();
+    }
+    
+    // Index the start of every line, a final newline doesn't start another line.
+    for (size_t offset = 0; offset < _size; ) {
+        _lines.push_back(offset);
+        const char *newline = (const char *)memchr(_data + offset, '\n', _size - offset);
+        if (!newline) break;
+        offset = newline - _data + 1;
+    }
+    
+    return true;
+}
+
+void Source::close(void) {
+    if (_mapped) munmap((void *)_data, _size);
+    
+    _data = nullptr;
+    _size = 0;
+    _mapped = false;
+    _contents.clear();
+    _lines.clear();
+    _next = 0;
+}
+
+bool Source::getline(std::string_view& line) {
+    if (_next >= _lines.size()) return false;
+    
+    size_t start = _lines[_next++];
+    size_t end = _next < _lines.size() ? _lines[_next] - 1 : _size;
+    if (end > start && _data[end - 1] == '\n') end--;
+    
+    line = std::string_view(_data + start, end - start);
+    return true;
+}
@@ -0,0 +1,82 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef SOURCE_HPP
+#define SOURCE_HPP
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pp {
+    /*
+     A source file mapped into memory, with the offset of every line indexed in a single
+     scan when the file is opened. Lines are handed out as views into the mapping, so no
+     line is ever copied unless it needs to be changed.
+     */
+    class Source {
+    public:
+        std::string pathname;
+        
+        Source() = default;
+        ~Source();
+        
+        bool open(const std::string& pathname);
+        void close(void);
+        
+        // Reads the next line, without its newline, returning false once there are no more lines.
+        bool getline(std::string_view& line);
+        
+        // returns the number of the line last read, the first line being line 1
+        long lineNumber(void) const {
+            return _next;
+        }
+        
+        long lineCount(void) const {
+            return _lines.size();
+        }
+        
+        std::string_view contents(void) const {
+            return std::string_view(_data ? _data : "", _size);
+        }
+        
+    private:
+        const char *_data = nullptr;
+        size_t _size = 0;
+        bool _mapped = false;
+        
+        // Used instead of a mapping when the file can't be mapped.
+        std::string _contents;
+        
+        std::vector<size_t> _lines;
+        size_t _next = 0;
+        
+        Source(const Source &);
+        Source& operator=(const Source &);
+    };
+}
+
+#endif /* SOURCE_HPP */
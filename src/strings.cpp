@@ -23,59 +23,49 @@
  */
 
 #include "strings.hpp"
-#include <regex>
+#include "patterns.hpp"
 
 using namespace pp;
 
+/*
+ Only the strings of the line most recently preserved are kept, a line that never gets its
+ strings restored, such as a preprocessor directive, must not leave its strings behind to be
+ restored into a later line.
+ */
 void Strings::preserveStrings(const std::string& str) {
-    std::regex re;
-    
-    re = R"("[^"]*")";
-    for (auto it = std::sregex_iterator(str.begin(), str.end(), re); it != std::sregex_iterator(); ++it ) {
+    _preservedStrings.clear();
+    for (auto it = Patterns::String.iterator(str); it != MatchIterator(); ++it ) {
         _preservedStrings.push_back(it->str());
     }
 }
 
 void Strings::blankOutStrings(std::string &str) {
-    std::regex re;
-    
-    re = R"("[^"]*")";
-    str = regex_replace(str, re, R"("")");
+    str = Patterns::String.replace(str, R"("")");
 }
 
-void Strings::restoreStrings(std::string& str) {
-    const std::regex re(R"("[^"]*")");
-
+/*
+ Only blanked out strings are restored, any string that has since been introduced, such as by
+ a macro, is left as it is.
+ */
+void Strings::restoreStrings(std::string& str) const {
     // If there are no preserved strings, return early
     if (_preservedStrings.empty()) return;
 
     std::string result;
-    auto inserter = std::back_inserter(result);
+    size_t position = 0;
+    auto preserved = _preservedStrings.begin();
 
-    auto it = std::sregex_iterator(str.begin(), str.end(), re);
-    auto end = std::sregex_iterator();
-
-    // Track the position after the last match
-    std::sregex_iterator last_iter = it;
-
-    for (; it != end && !_preservedStrings.empty(); ++it) {
-        // Append text before the match
-        inserter = std::copy(it->prefix().first, it->prefix().second, inserter);
+    for (auto it = Patterns::String.iterator(str); it != MatchIterator() && preserved != _preservedStrings.end(); ++it) {
+        if (it->length() != 2) continue;
         
-        // Insert the next preserved string
-        inserter = std::copy(_preservedStrings.front().begin(), _preservedStrings.front().end(), inserter);
-        _preservedStrings.pop_front();  // Remove the used preserved string
-
-        last_iter = it;
+        // Append text before the match, then the next preserved string in its place.
+        result.append(str, position, it->position() - position);
+        result.append(*preserved++);
+        position = it->position() + it->length();
     }
 
     // Handle the text after the last match
-    if (last_iter != end) {
-        inserter = std::copy(last_iter->suffix().first, last_iter->suffix().second, inserter);
-    } else {
-        // If no matches were found, copy the entire string
-        result = str;
-    }
+    result.append(str, position);
 
     // Update the input string with the modified result
     str = result;
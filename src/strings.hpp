@@ -27,16 +27,16 @@
 #define STRINGS_HPP
 
 #include <iostream>
-#include <list>
+#include <vector>
 
 namespace pp {
     class Strings {
     public:
         void preserveStrings(const std::string& str);
         void blankOutStrings(std::string& str);
-        void restoreStrings(std::string& str);
+        void restoreStrings(std::string& str) const;
     private:
-        std::list<std::string> _preservedStrings;
+        std::vector<std::string> _preservedStrings;
     };
 }
 
@@ -26,19 +26,17 @@
 
 #include "switch.hpp"
 #include "common.hpp"
+#include "context.hpp"
+#include "patterns.hpp"
 
-#include <regex>
 #include <sstream>
 
 using namespace pp;
 
 bool Switch::parse(std::string& str) {
-    std::regex re;
-    std::smatch match;
+    Match match;
     
-    Singleton *singleton = Singleton::shared();
-    
-    if (singleton->scope == Singleton::Scope::Global) {
+    if (_context.scope == Context::Scope::Global) {
         _sw = 0;
         return false;
     }
@@ -48,22 +46,19 @@ bool Switch::parse(std::string& str) {
      Group  0 switch expresion
             1 expresion
      */
-    re = R"(\bswitch *\((.+)\) *\{ *$)";
-    if (regex_search(str, match, re)) {
+    if (Patterns::SwitchStatement.search(str, match)) {
         std::string s = match.str();
         
-        auto it = std::sregex_token_iterator {
-            s.begin(), s.end(), re, {1}
-        };
-        if (it != std::sregex_token_iterator()) {
+        auto it = Patterns::SwitchStatement.tokenIterator(s, {1});
+        if (it != TokenIterator()) {
             std::ostringstream oss;
-            oss << std::string(Singleton::shared()->nestingLevel * INDENT_WIDTH, ' ') << "LOCAL sw" << ++_sw << " := " << *it << ";\n" << std::string((Singleton::shared()->nestingLevel - 1) * 2, ' ') << "CASE";
+            oss << std::string(_context.nestingLevel * INDENT_WIDTH, ' ') << "LOCAL sw" << ++_sw << " := " << *it << ";\n" << std::string((_context.nestingLevel - 1) * 2, ' ') << "CASE";
             str.replace(match.position(), match.str().length(), oss.str());
             oss.str("");
             oss << "sw" << _sw;
             _expressions.push_back({oss.str(), countLeadingCharacters(str, ' ')});
-            _level.push_back(Singleton::shared()->nestingLevel);
-            if (verbose) std::cout
+            _level.push_back(_context.nestingLevel);
+            if (verbose) _context.log
                 << MessageType::Verbose
                 << "switch"
                 << ": '" << *it << "' for expression defined\n";
@@ -75,30 +70,26 @@ bool Switch::parse(std::string& str) {
     if (!_expressions.size()) return false;
     TExpression exp = _expressions.back();
     
-    re = R"(\bCASE *(\-?\d+) *\:)";
-    if (regex_search(str, match, re)) {
-        str.replace(match.position(), match.str().length(), std::string(Singleton::shared()->nestingLevel * INDENT_WIDTH, ' ') + "IF " + exp.expression + " == " + match.str(1) + " THEN");
+    if (Patterns::CaseLabel.search(str, match)) {
+        str.replace(match.position(), match.str().length(), std::string(_context.nestingLevel * INDENT_WIDTH, ' ') + "IF " + exp.expression + " == " + match.str(1) + " THEN");
         return true;
     }
     
-    if (_level.front() == singleton->nestingLevel) {
-        re = R"(\bBREAK;)";
-        if (regex_search(str, match, re)) {
+    if (_level.front() == _context.nestingLevel) {
+        if (Patterns::BreakStatement.search(str, match)) {
             str.replace(match.position(), match.str().length(),"END;");
         }
         
-        re = R"(\bDEFAULT:)";
-        if (regex_search(str, match, re)) {
-            str.replace(match.position(), match.str().length(), std::string(Singleton::shared()->nestingLevel * INDENT_WIDTH, ' ') + "DEFAULT");
+        if (Patterns::DefaultLabel.search(str, match)) {
+            str.replace(match.position(), match.str().length(), std::string(_context.nestingLevel * INDENT_WIDTH, ' ') + "DEFAULT");
         }
         
         
     }
     
-    if (_level.front() == singleton->nestingLevel) {
-        re = R"(^ *\} *$)";
-        if (regex_match(str, match, re)) {
-            if (verbose) std::cout
+    if (_level.front() == _context.nestingLevel) {
+        if (Patterns::ClosingBraceOnly.match(str, match)) {
+            if (verbose) _context.log
                 << MessageType::Verbose
                 << "switch"
                 << ": '" << _expressions.back().expression << "' expression removed!\n";
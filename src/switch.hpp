@@ -31,12 +31,24 @@
 #include <vector>
 
 namespace pp {
+    class Context;
+    
     class Switch {
     public:
         bool verbose = false;
+        
+        Switch(Context& context) : _context(context) {}
+        
         bool parse(std::string& str);
         
+        // returns true while within a switch, where every line is subject to being parsed
+        bool active(void) const {
+            return !_expressions.empty();
+        }
+        
     private:
+        Context& _context;
+        
         typedef struct TExpression {
             std::string expression;
             long indeted;
@@ -26,8 +26,12 @@
 #define TIMER_HPP
 
 #include <iostream>
+#include <iomanip>
 #include <chrono>
 #include <thread>
+#include <string>
+#include <vector>
+#include <map>
 
 class Timer {
 public:
@@ -44,4 +48,240 @@ private:
     std::chrono::high_resolution_clock::time_point start_time_point;
 };
 
+/*
+ Accumulates the time spent in, and the number of calls to, each stage of the pipeline and
+ the time spent in each file being compiled.
+ 
+ Stages and files both nest, an #include is processed from within the preprocessor stage, so
+ the time of a stage or file excludes that of any stage or file nested within it. Each span
+ can also be recorded as it happens, for exporting as Chrome trace-event JSON.
+ */
+class Profiler {
+public:
+    enum class Stage {
+        Comments,
+        Lexer,
+        Preprocessor,
+        Operators,
+        Aliases,
+        Types,
+        Switch,
+        Scope,
+        Calc,
+        Formatting,
+        Output,
+        Optimizer,
+        Count
+    };
+    
+    bool enabled = false;
+    bool tracing = false;
+    
+    // Times a stage, or a run of stages one after another, for as long as it's in scope.
+    class Section {
+    public:
+        Section(Profiler& profiler, Stage stage) : _profiler(profiler.enabled ? &profiler : nullptr) {
+            if (_profiler) _profiler->begin(stage);
+        }
+        
+        ~Section() {
+            if (_profiler) _profiler->end();
+        }
+        
+        // Ends the stage being timed and starts timing the next one.
+        void next(Stage stage) {
+            if (!_profiler) return;
+            _profiler->end();
+            _profiler->begin(stage);
+        }
+        
+    private:
+        Profiler *_profiler;
+    };
+    
+    // Times a file being compiled for as long as it's in scope.
+    class File {
+    public:
+        File(Profiler& profiler, const std::string& pathname) : _profiler(profiler) {
+            _profiler.beginFile(pathname);
+        }
+        
+        ~File() {
+            _profiler.endFile();
+        }
+        
+    private:
+        Profiler& _profiler;
+    };
+    
+    static const char *name(Stage stage) {
+        static const char *names[] = {
+            "comments", "lexer", "preprocessor", "operators", "aliases", "types", "switch", "scope", "calc", "formatting", "output", "optimizer"
+        };
+        return names[(int)stage];
+    }
+    
+    void begin(Stage stage) {
+        long long now = nanoseconds();
+        if (!_stages.empty()) accrue(_stages.back().stage, now - _stages.back().resumed);
+        _stages.push_back({stage, now, now});
+        _stageTotals[(int)stage].calls++;
+    }
+    
+    void end() {
+        long long now = nanoseconds();
+        TStageFrame frame = _stages.back();
+        _stages.pop_back();
+        
+        accrue(frame.stage, now - frame.resumed);
+        if (!_stages.empty()) _stages.back().resumed = now;
+        if (tracing) _events.push_back({name(frame.stage), "stage", frame.start, now - frame.start});
+    }
+    
+    void beginFile(const std::string& pathname) {
+        if (!enabled) return;
+        
+        long long now = nanoseconds();
+        if (!_files.empty()) _fileTotals[_files.back().pathname].nanoseconds += now - _files.back().resumed;
+        _files.push_back({pathname, now, now});
+        _fileTotals[pathname].calls++;
+    }
+    
+    void endFile() {
+        if (!enabled) return;
+        
+        long long now = nanoseconds();
+        TFileFrame frame = _files.back();
+        _files.pop_back();
+        
+        _fileTotals[frame.pathname].nanoseconds += now - frame.resumed;
+        if (!_files.empty()) _files.back().resumed = now;
+        if (tracing) _events.push_back({frame.pathname, "file", frame.start, now - frame.start});
+    }
+    
+    /*
+     Adds in the stages timed by a profiler on another thread, working on behalf of this one
+     outside of any file, the spans it recorded being kept apart as those of another thread.
+     */
+    void merge(const Profiler& other) {
+        for (int i = 0; i < (int)Stage::Count; ++i) {
+            _stageTotals[i].calls += other._stageTotals[i].calls;
+            _stageTotals[i].nanoseconds += other._stageTotals[i].nanoseconds;
+            _merged += other._stageTotals[i].nanoseconds;
+        }
+        if (tracing) _threads.push_back(other._events);
+    }
+    
+    // returns the number of threads spans were recorded on, this one and any merged
+    size_t threadCount(void) const {
+        return 1 + _threads.size();
+    }
+    
+    /*
+     Prints the time and calls of each stage, followed by the time spent in each file, the
+     total being the time in files plus that of stages timed outside of any, so "other" is
+     only ever what the stages leave of it.
+     */
+    void printTable(std::ostream& os) const {
+        long long total = _merged + _outside;
+        
+        os << std::left << std::setw(28) << "stage" << std::right
+           << std::setw(12) << "calls" << std::setw(12) << "ms" << std::setw(8) << "%" << "\n";
+        for (const auto& totals : _fileTotals) total += totals.second.nanoseconds;
+        
+        TTotals other;
+        other.nanoseconds = total;
+        for (int i = 0; i < (int)Stage::Count; ++i) {
+            if (!_stageTotals[i].calls) continue;
+            row(os, name((Stage)i), _stageTotals[i], total);
+            other.nanoseconds -= _stageTotals[i].nanoseconds;
+        }
+        if (other.nanoseconds > 0) row(os, "other", other, total);
+        
+        os << "\n" << std::left << std::setw(28) << "file" << std::right
+           << std::setw(12) << "included" << std::setw(12) << "ms" << std::setw(8) << "%" << "\n";
+        for (const auto& totals : _fileTotals) {
+            row(os, totals.first.substr(totals.first.find_last_of("/") + 1), totals.second, total);
+        }
+    }
+    
+    /*
+     Writes every span recorded on one thread, the first being this one, as a complete ("X")
+     event of the given thread id, in microseconds, each event preceded by a comma unless
+     it's the very first event of the trace.
+     */
+    void writeTrace(std::ostream& os, int tid, bool& first, size_t thread = 0) const {
+        for (const auto& event : thread ? _threads[thread - 1] : _events) {
+            if (!first) os << ",\n";
+            first = false;
+            
+            os << "{\"name\":\"";
+            for (const char c : event.name) {
+                if (c == '"' || c == '\\') os << '\\';
+                os << c;
+            }
+            os << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+               << std::fixed << std::setprecision(3)
+               << ",\"ts\":" << event.start / 1e3 << ",\"dur\":" << event.duration / 1e3 << "}";
+        }
+    }
+    
+private:
+    typedef struct TTotals {
+        long long nanoseconds = 0;
+        long calls = 0;
+    } TTotals;
+    
+    typedef struct TStageFrame {
+        Stage stage;
+        long long start;
+        long long resumed;      // when the stage last started or carried on after a nested stage
+    } TStageFrame;
+    
+    typedef struct TFileFrame {
+        std::string pathname;
+        long long start;
+        long long resumed;
+    } TFileFrame;
+    
+    typedef struct TEvent {
+        std::string name;
+        const char *category;
+        long long start;
+        long long duration;
+    } TEvent;
+    
+    TTotals _stageTotals[(int)Stage::Count];
+    std::map<std::string, TTotals> _fileTotals;
+    
+    std::vector<TStageFrame> _stages;
+    std::vector<TFileFrame> _files;
+    std::vector<TEvent> _events;
+    
+    // The time of, and the spans recorded by, every profiler merged into this one
+    long long _merged = 0;
+    std::vector<std::vector<TEvent>> _threads;
+    
+    // The time of stages timed while no file was being compiled, such as the optimizer
+    long long _outside = 0;
+    
+    // Time since the first use of any profiler, so the spans of every program share the same timeline.
+    static long long nanoseconds() {
+        static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+    
+    void accrue(Stage stage, long long nanoseconds) {
+        _stageTotals[(int)stage].nanoseconds += nanoseconds;
+        if (_files.empty()) _outside += nanoseconds;
+    }
+    
+    static void row(std::ostream& os, const std::string& name, const TTotals& totals, long long total) {
+        os << std::left << std::setw(28) << name << std::right
+           << std::setw(12) << totals.calls
+           << std::setw(12) << std::fixed << std::setprecision(2) << totals.nanoseconds / 1e6
+           << std::setw(8) << std::setprecision(1) << (total ? 100.0 * totals.nanoseconds / total : 0) << "\n";
+    }
+};
+
 #endif /* TIMER_HPP */
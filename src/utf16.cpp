@@ -0,0 +1,212 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#include "utf16.hpp"
+
+#include <fstream>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+using namespace pp;
+
+UTF16Writer::UTF16Writer() {
+    _buffer.reserve(1 << 16);
+    _buffer.append("\xFF\xFE");
+}
+
+void UTF16Writer::write(const std::string& str) {
+    write(str.data(), str.length());
+}
+
+static inline uint8_t *put(uint8_t *out, uint16_t utf16) {
+    *out++ = utf16 & 0xFF;
+    *out++ = utf16 >> 8;
+    return out;
+}
+
+void UTF16Writer::write(const char *str, size_t length) {
+    /*
+     No UTF-8 sequence is ever more than twice as long once in UTF-16, a four byte sequence
+     becoming a surrogate pair, so room for twice the length is all that is ever needed.
+     */
+    size_t size = _buffer.size();
+    _buffer.resize(size + length * 2);
+    
+    const uint8_t *in = (const uint8_t *)str;
+    const uint8_t *end = in + length;
+    uint8_t *out = (uint8_t *)_buffer.data() + size;
+    
+    while (in < end) {
+        /*
+         Most of a program is ASCII, so 16 bytes at a time are checked for being plain ASCII,
+         with no carriage return, and widened in one go by interleaving them with zeros.
+         */
+#if defined(__SSE2__)
+        if (end - in >= 16) {
+            __m128i bytes = _mm_loadu_si128((const __m128i *)in);
+            int mask = _mm_movemask_epi8(_mm_or_si128(bytes, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r'))));
+            if (!mask) {
+                __m128i zero = _mm_setzero_si128();
+                _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi8(bytes, zero));
+                _mm_storeu_si128((__m128i *)(out + 16), _mm_unpackhi_epi8(bytes, zero));
+                in += 16;
+                out += 32;
+                continue;
+            }
+            
+            // Widen the ASCII before the first byte that needs to be dealt with on its own.
+            for (int n = __builtin_ctz(mask); n; --n) out = put(out, *in++);
+        }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        if (end - in >= 16) {
+            uint8x16_t bytes = vld1q_u8(in);
+            uint8x16_t special = vorrq_u8(vcgeq_u8(bytes, vdupq_n_u8(0x80)), vceqq_u8(bytes, vdupq_n_u8('\r')));
+            if (!vmaxvq_u8(special)) {
+                uint8x16x2_t wide = vzipq_u8(bytes, vdupq_n_u8(0));
+                vst1q_u8(out, wide.val[0]);
+                vst1q_u8(out + 16, wide.val[1]);
+                in += 16;
+                out += 32;
+                continue;
+            }
+        }
+#endif
+        uint8_t c = *in;
+        
+        if (c < 0x80) {
+            if (c != '\r') out = put(out, c);
+            in++;
+            continue;
+        }
+        
+        size_t n = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        uint32_t codepoint = 0xFFFD;
+        
+        // A stray continuation byte or a truncated sequence becomes the replacement character.
+        size_t i = 1;
+        while (i < n && in + i < end && (in[i] & 0b11000000) == 0b10000000) i++;
+        if (n > 1 && i == n) {
+            codepoint = c & (0x7F >> n);
+            for (i = 1; i < n; ++i) {
+                codepoint = codepoint << 6 | (in[i] & 0b111111);
+            }
+        }
+        else {
+            n = 1;
+        }
+        in += n;
+        
+        if (codepoint >= 0x10000) {
+            // Characters beyond the Basic Multilingual Plane are encoded as a surrogate pair.
+            codepoint -= 0x10000;
+            out = put(out, 0xD800 | codepoint >> 10);
+            out = put(out, 0xDC00 | (codepoint & 0x3FF));
+            continue;
+        }
+        out = put(out, codepoint);
+    }
+    
+    _buffer.resize(out - (uint8_t *)_buffer.data());
+}
+
+void UTF16Writer::splice(const std::vector<std::pair<size_t, std::string_view>>& insertions) {
+    if (insertions.empty()) return;
+    
+    std::string written = std::move(_buffer);
+    size_t position = 0;
+    
+    // The text being spliced in is no more than twice as long once transcoded, as for write().
+    size_t length = written.size();
+    for (const auto& insertion : insertions) length += insertion.second.length() * 2;
+    
+    _buffer = std::string();
+    _buffer.reserve(length);
+    
+    for (const auto& insertion : insertions) {
+        _buffer.append(written, position, insertion.first - position);
+        write(insertion.second.data(), insertion.second.length());
+        position = insertion.first;
+    }
+    _buffer.append(written, position);
+}
+
+std::string UTF16Writer::str(void) const {
+    std::string str;
+    str.reserve(_buffer.size() / 2);
+    
+    const uint8_t *in = (const uint8_t *)_buffer.data() + 2;
+    const uint8_t *end = (const uint8_t *)_buffer.data() + _buffer.size();
+    
+    while (in + 1 < end) {
+        uint32_t codepoint = in[0] | in[1] << 8;
+        in += 2;
+        
+        if (codepoint < 0x80) {
+            str += (char)codepoint;
+            continue;
+        }
+        
+        if (codepoint >= 0xD800 && codepoint < 0xDC00 && in + 1 < end) {
+            codepoint = 0x10000 + ((codepoint & 0x3FF) << 10 | ((in[0] | in[1] << 8) & 0x3FF));
+            in += 2;
+        }
+        
+        if (codepoint < 0x800) {
+            str += (char)(0xC0 | codepoint >> 6);
+        }
+        else if (codepoint < 0x10000) {
+            str += (char)(0xE0 | codepoint >> 12);
+            str += (char)(0x80 | (codepoint >> 6 & 0x3F));
+        }
+        else {
+            str += (char)(0xF0 | codepoint >> 18);
+            str += (char)(0x80 | (codepoint >> 12 & 0x3F));
+            str += (char)(0x80 | (codepoint >> 6 & 0x3F));
+        }
+        str += (char)(0x80 | (codepoint & 0x3F));
+    }
+    
+    return str;
+}
+
+void UTF16Writer::clear(void) {
+    _buffer.resize(2);
+}
+
+bool UTF16Writer::save(const std::string& pathname) const {
+    std::ofstream outfile;
+    
+    outfile.open(pathname, std::ios::out | std::ios::binary);
+    if (!outfile.is_open()) return false;
+    
+    outfile.write(_buffer.data(), _buffer.size());
+    outfile.close();
+    
+    return !outfile.fail();
+}
@@ -0,0 +1,76 @@
+/*
+ The MIT License (MIT)
+ 
+ Copyright (c) 2024 Insoft. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef UTF16_HPP
+#define UTF16_HPP
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+
+namespace pp {
+    /*
+     Transcodes UTF-8 text into UTF-16LE, as required by the "hpprgm" file format, into an
+     in-memory buffer that starts with the byte order mark. Nothing is written to disk
+     until the whole program has been transcoded and is saved in a single write.
+     */
+    class UTF16Writer {
+    public:
+        UTF16Writer();
+        
+        // Appends UTF-8 text, any carriage returns are dropped.
+        void write(const std::string& str);
+        void write(const char *str, size_t length);
+        
+        /*
+         Splices UTF-8 text in at each of the given offsets into what has been written, the
+         offsets being in ascending order, as returned by size() at the time.
+         */
+        void splice(const std::vector<std::pair<size_t, std::string_view>>& insertions);
+        
+        // Transcodes what has been written back into UTF-8.
+        std::string str(void) const;
+        
+        // Discards all that has been written.
+        void clear(void);
+        
+        bool save(const std::string& pathname) const;
+        
+        size_t size(void) const {
+            return _buffer.size();
+        }
+        
+        const std::string& data(void) const {
+            return _buffer;
+        }
+        
+    private:
+        std::string _buffer;
+    };
+}
+
+#endif /* UTF16_HPP */